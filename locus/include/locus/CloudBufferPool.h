@@ -0,0 +1,65 @@
+/*
+Authors:
+  - Matteo Palieri    (matteo.palieri@jpl.nasa.gov)
+  - Benjamin Morrell  (benjamin.morrell@jpl.nasa.gov)
+*/
+
+#ifndef LOCUS_CLOUD_BUFFER_POOL_H
+#define LOCUS_CLOUD_BUFFER_POOL_H
+
+#include <boost/make_shared.hpp>
+#include <frontend_utils/CommonStructs.h>
+#include <mutex>
+#include <vector>
+
+// Recycles the point cloud buffers allocated on the scan path. Handing a
+// fresh heap allocation to the filter every scan keeps downstream consumers
+// (odometry holds the previous scans, the map update thread holds queued
+// keyframes) safe, but the underlying point vectors are reallocated and
+// regrown each time. The pool hands out buffers whose deleter returns the
+// storage to a shared free list instead of freeing it: recycled buffers are
+// cleared but keep their vector capacity, so after warm-up each scan is
+// served at stable capacity without touching the heap. The free list is
+// reference counted by the outstanding handles, so buffers released after
+// the pool is destroyed are still reclaimed safely.
+class CloudBufferPool {
+public:
+  CloudBufferPool() : free_list_(boost::make_shared<FreeList>()) {}
+
+  // Returns an empty cloud, recycling a released buffer when one is
+  // available. Thread safe: the scan path and the map update thread
+  // release buffers concurrently
+  PointCloudF::Ptr Acquire() {
+    boost::shared_ptr<PointCloudF> buffer;
+    {
+      std::lock_guard<std::mutex> lock(free_list_->mutex);
+      if (!free_list_->buffers.empty()) {
+        buffer = free_list_->buffers.back();
+        free_list_->buffers.pop_back();
+      }
+    }
+    if (buffer == nullptr)
+      buffer = boost::make_shared<PointCloudF>();
+    // clear() empties the point vector but keeps its capacity
+    buffer->clear();
+
+    boost::shared_ptr<FreeList> free_list = free_list_;
+    return PointCloudF::Ptr(buffer.get(),
+                            [buffer, free_list](PointCloudF*) mutable {
+                              std::lock_guard<std::mutex> lock(
+                                  free_list->mutex);
+                              free_list->buffers.push_back(buffer);
+                              buffer.reset();
+                            });
+  }
+
+private:
+  struct FreeList {
+    std::mutex mutex;
+    std::vector<boost::shared_ptr<PointCloudF>> buffers;
+  };
+
+  boost::shared_ptr<FreeList> free_list_;
+};
+
+#endif
@@ -9,6 +9,9 @@ Authors:
 
 #include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <thread>
 
 #include <diagnostic_msgs/DiagnosticArray.h>
 #include <diagnostic_msgs/DiagnosticStatus.h>
@@ -18,6 +21,10 @@ Authors:
 #include <geometry_msgs/PoseStamped.h>
 #include <geometry_utils/GeometryUtilsROS.h>
 #include <geometry_utils/Transform3.h>
+#include <locus/CloudBufferPool.h>
+#include <locus/ScanLogger.h>
+#include <locus/StageProfiler.h>
+#include <locus/StampedRingBuffer.h>
 #include <math.h>
 #include <message_filters/subscriber.h>
 #include <mutex>
@@ -38,6 +45,7 @@ Authors:
 #include <sensor_msgs/PointCloud2.h>
 #include <std_msgs/Bool.h>
 #include <std_msgs/Float64.h>
+#include <std_msgs/Int32.h>
 #include <std_msgs/String.h>
 #include <std_msgs/Time.h>
 #include <tf/message_filter.h>
@@ -56,8 +64,8 @@ class Locus {
 public:
   typedef sensor_msgs::Imu Imu;
   typedef nav_msgs::Odometry Odometry;
-  typedef std::map<double, Imu> ImuBuffer;
-  typedef std::map<double, Odometry> OdometryBuffer;
+  typedef StampedRingBuffer<Imu> ImuBuffer;
+  typedef StampedRingBuffer<Odometry> OdometryBuffer;
   typedef Imu::ConstPtr ImuConstPtr;
   typedef Odometry::ConstPtr OdometryConstPtr;
 
@@ -78,6 +86,7 @@ private:
   bool b_verbose_;
 
   bool LoadParameters(const ros::NodeHandle& n);
+  bool ApplyThreadBudget(const ros::NodeHandle& n);
   bool RegisterCallbacks(const ros::NodeHandle& n, bool from_log);
   bool RegisterLogCallbacks(const ros::NodeHandle& n);
   bool RegisterOnlineCallbacks(const ros::NodeHandle& n);
@@ -118,6 +127,13 @@ private:
   int imu_queue_size_;
   int odom_queue_size_;
 
+  // Latest-scan-wins scheduling: when the lidar queue already holds a newer
+  // scan on callback entry, skip the current one so processing always
+  // consumes the freshest data at bounded staleness
+  bool b_latest_scan_wins_;
+  int skipped_scans_count_;
+  ros::Publisher skipped_scans_pub_;
+
   ImuBuffer imu_buffer_;
   OdometryBuffer odometry_buffer_;
 
@@ -174,7 +190,6 @@ private:
   bool b_pcld_received_;
   int pcld_seq_prev_;
 
-  PointCloudF::Ptr msg_filtered_;
   PointCloudF::Ptr msg_transformed_;
   PointCloudF::Ptr msg_neighbors_;
   PointCloudF::Ptr msg_base_;
@@ -182,6 +197,11 @@ private:
   PointCloudF::Ptr mapper_unused_fixed_;
   PointCloudF::Ptr mapper_unused_out_;
 
+  // Recycles the clouds allocated per scan (filtered scans, queued
+  // keyframes) so their storage stabilizes instead of being reallocated
+  // every cycle
+  CloudBufferPool cloud_pool_;
+
   /*--------------
   Data integration
   --------------*/
@@ -228,7 +248,6 @@ private:
 
   bool b_enable_computation_time_profiling_;
   ros::Publisher lidar_callback_duration_pub_;
-  ros::Time lidar_callback_start_;
 
   /* -------------------------
   Ground Truth
@@ -238,6 +257,15 @@ private:
   bool b_run_with_gt_point_cloud_;
   void InitWithGTPointCloud(const std::string filename);
 
+  // Streaming initializer for binary PCDs: memory-maps the data section and
+  // inserts it in bounded chunks instead of materializing the whole cloud.
+  // Returns false for formats it cannot stream (ascii, binary_compressed),
+  // in which case the caller falls back to the one-shot reader
+  bool StreamGTPointCloud(const std::string& filename);
+  int gt_chunk_size_;
+  bool b_gt_load_around_start_pose_;
+  double gt_load_radius_;
+
   /* -------------------------
   Diagnostics
   ------------------------- */
@@ -309,6 +337,46 @@ private:
   uint points_to_process_in_callback_{3001};
   void ApplyAdaptiveInputVoxelization(const PointCloudF::ConstPtr& msg);
 
+  /*----------------------------------
+  Scan logging
+  ----------------------------------*/
+
+  // Appends the filtered scans plus the closest IMU/odometry samples to a
+  // compact binary log (see ScanLogger.h) for deterministic offline replay
+  bool b_log_scans_;
+  std::string scan_log_path_;
+  ScanLogWriter scan_log_writer_;
+
+  /*----------------------------------
+  Per-stage profiling
+  ----------------------------------*/
+
+  // Null when profiling is disabled so the scoped timers skip clock reads
+  StageProfiler* Profiler() {
+    return b_enable_computation_time_profiling_ ? &stage_profiler_ : nullptr;
+  }
+  void PublishProfilingSummaries(const ros::TimerEvent& ev);
+  StageProfiler stage_profiler_;
+  ros::Publisher profiling_pub_;
+  ros::Timer profiling_pub_timer_;
+
+  /*----------------------------------
+  Closed-loop latency controller
+  ----------------------------------*/
+
+  // Drives the input voxel leaf size and the localization iteration cap
+  // from the measured callback duration against a target deadline, with a
+  // deadband so the actuators do not thrash. Replaces the open-loop
+  // point-count heuristic when enabled
+  void ApplyLatencyController(double callback_duration);
+  bool b_enable_latency_controller_;
+  double target_callback_duration_;
+  double latency_deadband_ratio_;
+  int min_registration_iterations_;
+  int baseline_registration_iterations_;
+  int current_registration_iterations_;
+  double smoothed_callback_duration_;
+
   /*---------------
   Dynamic Switching
   ---------------*/
@@ -329,16 +397,75 @@ private:
   Mutex
   ---*/
 
-  std::mutex imu_buffer_mutex_;
-  std::mutex odometry_buffer_mutex_;
   std::mutex tf2_ros_odometry_buffer_mutex_;
   std::mutex latest_pose_mutex_;
+  // Signaled by OdometryCallback when a new odometry transform lands so
+  // IntegrateInterpolatedOdom wakes without sleep-polling
+  std::mutex odom_arrival_mutex_;
+  std::condition_variable odom_arrival_cv_;
 
   /*--------
   Timer Flag
   --------*/
 
   bool b_pub_odom_on_timer_;
+
+  /*------------------
+  Pipelined execution
+  ------------------*/
+
+  // A scan that has been filtered on the lidar spinner thread and is
+  // waiting to be registered by the registration thread
+  struct ScanBundle {
+    PointCloudF::ConstPtr msg;
+    PointCloudF::Ptr msg_filtered;
+    ros::Time callback_start;
+  };
+
+  // Registration stage of LidarCallback: sensor integration, scan-to-scan
+  // and scan-to-map registration, keyframe insertion
+  void ProcessScanRegistration(const PointCloudF::ConstPtr& msg,
+                               const PointCloudF::Ptr& msg_filtered,
+                               const ros::Time& callback_start);
+  void RegistrationThread();
+
+  bool b_pipelined_execution_;
+  int registration_queue_size_;
+  std::deque<ScanBundle> registration_queue_;
+  std::mutex registration_queue_mutex_;
+  std::condition_variable registration_queue_cv_;
+  std::thread registration_thread_;
+  bool b_shutdown_registration_thread_{false};
+
+  /*-----------------------
+  Asynchronous map updates
+  -----------------------*/
+
+  // A keyframe scan already transformed to the fixed frame, waiting to be
+  // inserted in the map by the map update thread
+  struct MapUpdateTask {
+    PointCloudF::Ptr points_fixed;
+    geometry_utils::Transform3 pose;
+    bool b_refresh;
+    bool b_publish_map;
+  };
+
+  void MapUpdateThread();
+
+  bool b_async_map_update_;
+  std::deque<MapUpdateTask> map_update_queue_;
+
+  // Register query and extracted neighborhood directly in the fixed frame,
+  // skipping the per-scan rewrite of the neighborhood into the sensor frame
+  bool b_registration_in_fixed_frame_;
+  std::mutex map_update_queue_mutex_;
+  std::condition_variable map_update_queue_cv_;
+  std::thread map_update_thread_;
+  bool b_shutdown_map_update_thread_{false};
+
+  // Serializes mapper insertions/refreshes against the nearest-neighbor
+  // queries issued from the registration path
+  std::mutex mapper_mutex_;
 };
 
 #endif
@@ -0,0 +1,252 @@
+/*
+Authors:
+  - Matteo Palieri    (matteo.palieri@jpl.nasa.gov)
+  - Benjamin Morrell  (benjamin.morrell@jpl.nasa.gov)
+*/
+
+#ifndef LOCUS_SCAN_LOGGER_H
+#define LOCUS_SCAN_LOGGER_H
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <frontend_utils/CommonStructs.h>
+#include <nav_msgs/Odometry.h>
+#include <sensor_msgs/Imu.h>
+
+// Compact binary scan-log format: a fixed file header followed by one
+// record per scan, each a fixed-stride header plus a fixed-stride point
+// block. Everything is fixed stride so an mmap-based reader (or numpy
+// frombuffer, see scripts/scan_log_reader.py) can walk the file zero-copy.
+// Writing goes through a large sequential buffer so the on-robot cost is
+// one memcpy per point block and an occasional aligned write().
+
+namespace scan_log {
+
+constexpr char kMagic[8] = {'L', 'O', 'C', 'U', 'S', 'L', 'O', 'G'};
+constexpr uint32_t kVersion = 1;
+
+#pragma pack(push, 1)
+
+struct FileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t point_stride;
+};
+
+// One logged point: the PointF fields without the SSE padding
+struct LoggedPoint {
+  float x, y, z;
+  float intensity;
+  float normal_x, normal_y, normal_z;
+  float curvature;
+};
+
+struct RecordHeader {
+  double stamp;
+  uint32_t point_count;
+  uint8_t has_imu;
+  uint8_t has_odometry;
+  uint8_t pad[2];
+  // Orientation quaternion (x y z w), angular velocity, linear acceleration
+  double imu[10];
+  // Position, orientation quaternion (x y z w), linear twist, angular twist
+  double odometry[13];
+};
+
+#pragma pack(pop)
+
+} // namespace scan_log
+
+// Appends scan records to a log file through a 1 MiB sequential buffer
+class ScanLogWriter {
+public:
+  ScanLogWriter() : fd_(-1) {}
+
+  ~ScanLogWriter() {
+    Close();
+  }
+
+  bool Open(const std::string& path) {
+    fd_ = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd_ < 0)
+      return false;
+    buffer_.reserve(kBufferSize);
+    scan_log::FileHeader header;
+    memcpy(header.magic, scan_log::kMagic, sizeof(header.magic));
+    header.version = scan_log::kVersion;
+    header.point_stride = sizeof(scan_log::LoggedPoint);
+    Write(&header, sizeof(header));
+    return true;
+  }
+
+  // Appends one scan with the sensor state closest to its stamp. Null imu
+  // or odometry pointers mark the snapshot as absent
+  void Append(const PointCloudF& cloud,
+              double stamp,
+              const sensor_msgs::Imu* imu,
+              const nav_msgs::Odometry* odometry) {
+    if (fd_ < 0)
+      return;
+    scan_log::RecordHeader record;
+    memset(&record, 0, sizeof(record));
+    record.stamp = stamp;
+    record.point_count = static_cast<uint32_t>(cloud.size());
+    if (imu != nullptr) {
+      record.has_imu = 1;
+      record.imu[0] = imu->orientation.x;
+      record.imu[1] = imu->orientation.y;
+      record.imu[2] = imu->orientation.z;
+      record.imu[3] = imu->orientation.w;
+      record.imu[4] = imu->angular_velocity.x;
+      record.imu[5] = imu->angular_velocity.y;
+      record.imu[6] = imu->angular_velocity.z;
+      record.imu[7] = imu->linear_acceleration.x;
+      record.imu[8] = imu->linear_acceleration.y;
+      record.imu[9] = imu->linear_acceleration.z;
+    }
+    if (odometry != nullptr) {
+      record.has_odometry = 1;
+      record.odometry[0] = odometry->pose.pose.position.x;
+      record.odometry[1] = odometry->pose.pose.position.y;
+      record.odometry[2] = odometry->pose.pose.position.z;
+      record.odometry[3] = odometry->pose.pose.orientation.x;
+      record.odometry[4] = odometry->pose.pose.orientation.y;
+      record.odometry[5] = odometry->pose.pose.orientation.z;
+      record.odometry[6] = odometry->pose.pose.orientation.w;
+      record.odometry[7] = odometry->twist.twist.linear.x;
+      record.odometry[8] = odometry->twist.twist.linear.y;
+      record.odometry[9] = odometry->twist.twist.linear.z;
+      record.odometry[10] = odometry->twist.twist.angular.x;
+      record.odometry[11] = odometry->twist.twist.angular.y;
+      record.odometry[12] = odometry->twist.twist.angular.z;
+    }
+    Write(&record, sizeof(record));
+
+    for (const auto& p : cloud.points) {
+      scan_log::LoggedPoint lp;
+      lp.x = p.x;
+      lp.y = p.y;
+      lp.z = p.z;
+      lp.intensity = p.intensity;
+      lp.normal_x = p.normal_x;
+      lp.normal_y = p.normal_y;
+      lp.normal_z = p.normal_z;
+      lp.curvature = p.curvature;
+      Write(&lp, sizeof(lp));
+    }
+  }
+
+  void Close() {
+    if (fd_ < 0)
+      return;
+    Flush();
+    close(fd_);
+    fd_ = -1;
+  }
+
+private:
+  static constexpr size_t kBufferSize = 1 << 20;
+
+  void Write(const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    buffer_.insert(buffer_.end(), bytes, bytes + size);
+    if (buffer_.size() >= kBufferSize)
+      Flush();
+  }
+
+  void Flush() {
+    size_t written = 0;
+    while (written < buffer_.size()) {
+      const ssize_t n =
+          write(fd_, buffer_.data() + written, buffer_.size() - written);
+      if (n <= 0)
+        break;
+      written += static_cast<size_t>(n);
+    }
+    buffer_.clear();
+  }
+
+  int fd_;
+  std::vector<uint8_t> buffer_;
+};
+
+// Walks a scan log through a read-only mapping; the record header and
+// point block views point straight into the mapped file
+class ScanLogReader {
+public:
+  ScanLogReader() : mapped_(nullptr), size_(0), offset_(0) {}
+
+  ~ScanLogReader() {
+    Close();
+  }
+
+  bool Open(const std::string& path) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+      return false;
+    struct stat file_stat;
+    fstat(fd, &file_stat);
+    size_ = static_cast<size_t>(file_stat.st_size);
+    mapped_ = static_cast<const uint8_t*>(
+        mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0));
+    close(fd);
+    if (mapped_ == MAP_FAILED) {
+      mapped_ = nullptr;
+      return false;
+    }
+    madvise(const_cast<uint8_t*>(mapped_), size_, MADV_SEQUENTIAL);
+    if (size_ < sizeof(scan_log::FileHeader))
+      return false;
+    const scan_log::FileHeader* header =
+        reinterpret_cast<const scan_log::FileHeader*>(mapped_);
+    if (memcmp(header->magic, scan_log::kMagic, sizeof(header->magic)) != 0 ||
+        header->version != scan_log::kVersion ||
+        header->point_stride != sizeof(scan_log::LoggedPoint))
+      return false;
+    offset_ = sizeof(scan_log::FileHeader);
+    return true;
+  }
+
+  // Advances to the next record. The returned pointers stay valid until
+  // Close()
+  bool Next(const scan_log::RecordHeader** record,
+            const scan_log::LoggedPoint** points) {
+    if (mapped_ == nullptr ||
+        offset_ + sizeof(scan_log::RecordHeader) > size_)
+      return false;
+    *record =
+        reinterpret_cast<const scan_log::RecordHeader*>(mapped_ + offset_);
+    offset_ += sizeof(scan_log::RecordHeader);
+    const size_t block_size =
+        static_cast<size_t>((*record)->point_count) *
+        sizeof(scan_log::LoggedPoint);
+    if (offset_ + block_size > size_)
+      return false;
+    *points =
+        reinterpret_cast<const scan_log::LoggedPoint*>(mapped_ + offset_);
+    offset_ += block_size;
+    return true;
+  }
+
+  void Close() {
+    if (mapped_ != nullptr) {
+      munmap(const_cast<uint8_t*>(mapped_), size_);
+      mapped_ = nullptr;
+    }
+  }
+
+private:
+  const uint8_t* mapped_;
+  size_t size_;
+  size_t offset_;
+};
+
+#endif
@@ -0,0 +1,144 @@
+/*
+Authors:
+  - Matteo Palieri    (matteo.palieri@jpl.nasa.gov)
+  - Benjamin Morrell  (benjamin.morrell@jpl.nasa.gov)
+*/
+
+#ifndef LOCUS_STAGE_PROFILER_H
+#define LOCUS_STAGE_PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+
+// Accumulates per-stage duration histograms for the scan pipeline so the
+// published summaries can say which stage caused a deadline miss without a
+// rebuild. Durations land in log-spaced bins (1 us to 10 s) via a single
+// relaxed atomic increment, so recording is lock-free and safe from both
+// the registration and the map update thread. Snapshots drain the bins,
+// making each published summary cover exactly one reporting window.
+class StageProfiler {
+public:
+  enum Stage {
+    FILTER = 0,
+    PRIOR_INTEGRATION,
+    SCAN_TO_SCAN_ICP,
+    NN_EXTRACTION,
+    SCAN_TO_MAP_ICP,
+    MAP_INSERT,
+    NUM_STAGES
+  };
+
+  static const char* StageName(size_t stage) {
+    static const char* names[NUM_STAGES] = {"filter",
+                                            "prior_integration",
+                                            "scan_to_scan_icp",
+                                            "nn_extraction",
+                                            "scan_to_map_icp",
+                                            "map_insert"};
+    return names[stage];
+  }
+
+  struct Summary {
+    double p50{0.0};
+    double p95{0.0};
+    double p99{0.0};
+    uint64_t count{0};
+  };
+
+  StageProfiler() {
+    for (size_t s = 0; s < NUM_STAGES; s++)
+      for (size_t b = 0; b < kNumBins; b++)
+        bins_[s][b].store(0, std::memory_order_relaxed);
+  }
+
+  void Record(size_t stage, double seconds) {
+    bins_[stage][BinIndex(seconds)].fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // Drains the stage's histogram and returns the percentiles of the drained
+  // window. Percentiles are reported as the upper edge of the bin where the
+  // cumulative count crosses the rank, so they are conservative by at most
+  // one bin width (~29% in duration)
+  Summary Snapshot(size_t stage) {
+    uint64_t counts[kNumBins];
+    Summary summary;
+    for (size_t b = 0; b < kNumBins; b++) {
+      counts[b] = bins_[stage][b].exchange(0, std::memory_order_relaxed);
+      summary.count += counts[b];
+    }
+    if (summary.count == 0)
+      return summary;
+    summary.p50 = Percentile(counts, summary.count, 0.50);
+    summary.p95 = Percentile(counts, summary.count, 0.95);
+    summary.p99 = Percentile(counts, summary.count, 0.99);
+    return summary;
+  }
+
+private:
+  // 64 geometric bins spanning 1 us to 10 s
+  static constexpr size_t kNumBins = 64;
+  static constexpr double kMinDuration = 1e-6;
+  static constexpr double kMaxDuration = 10.0;
+
+  static size_t BinIndex(double seconds) {
+    if (seconds <= kMinDuration)
+      return 0;
+    const double log_span = std::log(kMaxDuration / kMinDuration);
+    const double position =
+        std::log(seconds / kMinDuration) / log_span * (kNumBins - 1);
+    if (position >= static_cast<double>(kNumBins - 1))
+      return kNumBins - 1;
+    return static_cast<size_t>(position);
+  }
+
+  static double BinUpperEdge(size_t bin) {
+    const double log_span = std::log(kMaxDuration / kMinDuration);
+    return kMinDuration *
+        std::exp(log_span * static_cast<double>(bin + 1) /
+                 static_cast<double>(kNumBins - 1));
+  }
+
+  static double
+  Percentile(const uint64_t* counts, uint64_t total, double quantile) {
+    const uint64_t rank =
+        static_cast<uint64_t>(std::ceil(quantile * static_cast<double>(total)));
+    uint64_t cumulative = 0;
+    for (size_t b = 0; b < kNumBins; b++) {
+      cumulative += counts[b];
+      if (cumulative >= rank)
+        return BinUpperEdge(b);
+    }
+    return BinUpperEdge(kNumBins - 1);
+  }
+
+  std::atomic<uint64_t> bins_[NUM_STAGES][kNumBins];
+};
+
+// Times the enclosing scope and records it under the given stage. Pass a
+// null profiler when profiling is disabled: the timer then skips the clock
+// reads entirely
+class ScopedStageTimer {
+public:
+  ScopedStageTimer(StageProfiler* profiler, size_t stage)
+    : profiler_(profiler), stage_(stage) {
+    if (profiler_ != nullptr)
+      start_ = std::chrono::steady_clock::now();
+  }
+
+  ~ScopedStageTimer() {
+    if (profiler_ != nullptr) {
+      const std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start_;
+      profiler_->Record(stage_, elapsed.count());
+    }
+  }
+
+private:
+  StageProfiler* profiler_;
+  size_t stage_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+#endif
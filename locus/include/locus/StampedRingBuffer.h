@@ -0,0 +1,163 @@
+/*
+Authors:
+  - Matteo Palieri    (matteo.palieri@jpl.nasa.gov)
+  - Benjamin Morrell  (benjamin.morrell@jpl.nasa.gov)
+*/
+
+#ifndef LOCUS_STAMPED_RING_BUFFER_H
+#define LOCUS_STAMPED_RING_BUFFER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+
+// Fixed-capacity, preallocated ring buffer indexed by message timestamp.
+// Insertion is lock-free for a single producer (the sensor callback) and
+// lookups from the lidar thread are wait-free except when they race with
+// an overwrite of the slot being read, in which case the lookup retries.
+// Messages are assumed to arrive in timestamp order, which holds for the
+// IMU and odometry drivers we subscribe to. Once the buffer is full the
+// oldest entry is overwritten, matching the previous size-limited
+// std::map buffers.
+template <typename MsgType>
+class StampedRingBuffer {
+public:
+  StampedRingBuffer() : capacity_(0), head_(0) {}
+
+  // Must be called before the producer starts inserting
+  void SetCapacity(size_t capacity) {
+    capacity_ = capacity;
+    slots_.reset(new Slot[capacity]);
+    head_.store(0, std::memory_order_relaxed);
+  }
+
+  size_t Size() const {
+    return std::min<uint64_t>(head_.load(std::memory_order_acquire),
+                              capacity_);
+  }
+
+  bool Empty() const {
+    return head_.load(std::memory_order_acquire) == 0;
+  }
+
+  // Single-producer insertion: stamps the slot with an odd sequence number
+  // while it is being written so concurrent readers can detect the tear
+  void Insert(const MsgType& msg) {
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    Slot& slot = slots_[head % capacity_];
+    slot.seq.store(2 * head + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.stamp = msg.header.stamp.toSec();
+    slot.msg = msg;
+    slot.seq.store(2 * (head + 1), std::memory_order_release);
+    head_.store(head + 1, std::memory_order_release);
+  }
+
+  // Retrieves the entry closest in time to query_stamp and reports the
+  // signed time difference to the caller, which applies its own rejection
+  // threshold. Returns false if the buffer is empty or the relevant entries
+  // kept being overwritten while we were searching
+  bool GetClosest(double query_stamp, MsgType* msg, double* time_diff) const {
+    for (int attempt = 0; attempt < kMaxLookupAttempts; ++attempt) {
+      uint64_t head = head_.load(std::memory_order_acquire);
+      if (head == 0) {
+        return false;
+      }
+      uint64_t count = std::min<uint64_t>(head, capacity_);
+      uint64_t begin = head - count;
+
+      // Binary search for the first entry with stamp >= query_stamp
+      uint64_t lo = begin;
+      uint64_t hi = head;
+      bool torn = false;
+      while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        double stamp;
+        if (!ReadStamp(mid, &stamp)) {
+          torn = true;
+          break;
+        }
+        if (stamp < query_stamp) {
+          lo = mid + 1;
+        } else {
+          hi = mid;
+        }
+      }
+      if (torn) {
+        continue;
+      }
+
+      // The closest entry is either lo or its predecessor
+      uint64_t best = head;
+      double best_diff = 0.0;
+      for (uint64_t index : {lo, lo - 1}) {
+        if (index < begin || index >= head) {
+          continue;
+        }
+        double stamp;
+        if (!ReadStamp(index, &stamp)) {
+          torn = true;
+          break;
+        }
+        double diff = stamp - query_stamp;
+        if (best == head || std::fabs(diff) < std::fabs(best_diff)) {
+          best = index;
+          best_diff = diff;
+        }
+      }
+      if (torn || best == head) {
+        continue;
+      }
+
+      if (!ReadSlot(best, msg)) {
+        continue;
+      }
+      *time_diff = best_diff;
+      return true;
+    }
+    return false;
+  }
+
+private:
+  struct Slot {
+    std::atomic<uint64_t> seq{0};
+    double stamp{0.0};
+    MsgType msg;
+  };
+
+  static const int kMaxLookupAttempts = 4;
+
+  // Seqlock-style validated reads: the slot holding logical entry index is
+  // valid only while its sequence number equals 2 * (index + 1)
+  bool ReadStamp(uint64_t index, double* stamp) const {
+    const Slot& slot = slots_[index % capacity_];
+    uint64_t seq = slot.seq.load(std::memory_order_acquire);
+    if (seq != 2 * (index + 1)) {
+      return false;
+    }
+    *stamp = slot.stamp;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot.seq.load(std::memory_order_relaxed) == seq;
+  }
+
+  bool ReadSlot(uint64_t index, MsgType* msg) const {
+    const Slot& slot = slots_[index % capacity_];
+    uint64_t seq = slot.seq.load(std::memory_order_acquire);
+    if (seq != 2 * (index + 1)) {
+      return false;
+    }
+    *msg = slot.msg;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot.seq.load(std::memory_order_relaxed) == seq;
+  }
+
+  size_t capacity_;
+  std::unique_ptr<Slot[]> slots_;
+  // Total number of entries ever inserted; the live window is
+  // [head_ - min(head_, capacity_), head_)
+  std::atomic<uint64_t> head_;
+};
+
+#endif
@@ -0,0 +1,105 @@
+/*
+Authors:
+  - Matteo Palieri    (matteo.palieri@jpl.nasa.gov)
+  - Benjamin Morrell  (benjamin.morrell@jpl.nasa.gov)
+*/
+
+#ifndef LOCUS_VOXEL_HASH_MAPPER_H
+#define LOCUS_VOXEL_HASH_MAPPER_H
+
+#include <mutex>
+#include <vector>
+
+#include <pcl_ros/point_cloud.h>
+#include <ros/ros.h>
+
+#include <frontend_utils/CommonStructs.h>
+#include <geometry_utils/Transform3.h>
+#include <point_cloud_mapper/IPointCloudMapper.h>
+
+// Sliding-window local mapper backed by a rolling voxel-hash ring buffer
+// centered on the robot. Voxel coordinates wrap modulo a power-of-two
+// number of cells per axis, so a slot whose stored coordinate no longer
+// matches the incoming one is simply reclaimed in place: eviction of
+// out-of-window voxels is O(1) per cell as the window slides and Refresh
+// never re-filters the map. Selected in lo_settings.yaml with
+// window_local_mapping_type: voxel_hash_mapper
+
+class VoxelHashMapper : public IPointCloudMapper {
+public:
+  VoxelHashMapper();
+  virtual ~VoxelHashMapper();
+
+  virtual bool Initialize(const ros::NodeHandle& n);
+
+  virtual void SetBoxFilterSize(const int box_filter_size);
+  virtual void SetupNumberThreads(const int number_of_threads);
+
+  // Inserts the in-window points into their voxels; points appended to a
+  // voxel beyond max_points_per_voxel are dropped. incremental_points
+  // receives the points that were actually stored
+  virtual bool InsertPoints(const PointCloudF::ConstPtr& points,
+                            PointCloudF* incremental_points);
+
+  // For each query point returns the closest stored point from the
+  // surrounding 3x3x3 voxel neighborhood, querying the hash directly
+  virtual bool ApproxNearestNeighbors(const PointCloudF& points,
+                                      PointCloudF* neighbors);
+
+  virtual void UpdateCurrentPose(const geometry_utils::Transform3& pose);
+
+  // Window maintenance is implicit in the ring indexing, so this only
+  // recenters the window: O(1), no stop-the-world re-filter
+  virtual void Refresh(const geometry_utils::Transform3& current_pose);
+
+  virtual void PublishMap();
+
+  virtual void Reset();
+
+private:
+  // One ring-buffer slot. coord identifies the voxel the slot currently
+  // holds; when an insert maps a different coordinate to the same slot
+  // the stale cell is cleared and repossessed
+  struct Cell {
+    bool valid;
+    Eigen::Vector3i coord;
+    std::vector<PointF, Eigen::aligned_allocator<PointF>> points;
+  };
+
+  bool LoadParameters(const ros::NodeHandle& n);
+  bool CreatePublishers(const ros::NodeHandle& n);
+
+  Eigen::Vector3i VoxelCoord(const float x, const float y, const float z) const;
+  size_t SlotIndex(const Eigen::Vector3i& coord) const;
+  bool InWindow(const Eigen::Vector3i& coord) const;
+
+  // The node's name, for debugging
+  std::string name_;
+
+  std::string fixed_frame_id_;
+
+  // Voxel edge length in meters
+  double resolution_;
+  int max_points_per_voxel_;
+
+  int box_filter_size_;
+  int num_threads_;
+
+  // Cells per axis is a power of two so the wrap is a mask
+  int cells_per_axis_;
+  int coord_mask_;
+  int axis_shift_;
+  int window_half_cells_;
+  std::vector<Cell> cells_;
+
+  // Voxel coordinate of the window center, updated from the robot pose
+  Eigen::Vector3i center_coord_;
+
+  // Guards the ring buffer against concurrent inserts (async map update
+  // thread) and queries (lidar callback)
+  mutable std::mutex cells_mutex_;
+
+  ros::Publisher map_pub_;
+};
+
+#endif
@@ -5,6 +5,14 @@ Authors:
 */
 
 #include <locus/Locus.h>
+#include <locus/VoxelHashMapper.h>
+
+#include <fcntl.h>
+#include <omp.h>
+#include <pcl/io/pcd_io.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace pu = parameter_utils;
 namespace gu = geometry_utils;
@@ -16,7 +24,6 @@ Locus::Locus()
   : b_add_first_scan_to_key_(true),
     counter_(0),
     b_pcld_received_(false),
-    msg_filtered_(new PointCloudF()),
     msg_transformed_(new PointCloudF()),
     msg_neighbors_(new PointCloudF()),
     msg_base_(new PointCloudF()),
@@ -35,11 +42,33 @@ Locus::Locus()
     publish_diagnostics_(false),
     tf_buffer_authority_("transform_odometry"),
     scans_dropped_(0),
+    b_latest_scan_wins_(false),
+    skipped_scans_count_(0),
+    b_enable_latency_controller_(false),
+    smoothed_callback_duration_(0.0),
+    b_log_scans_(false),
     previous_stamp_(0) {
   double_param.value = 0.25;
 }
 
-Locus::~Locus() {}
+Locus::~Locus() {
+  if (registration_thread_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(registration_queue_mutex_);
+      b_shutdown_registration_thread_ = true;
+    }
+    registration_queue_cv_.notify_one();
+    registration_thread_.join();
+  }
+  if (map_update_thread_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(map_update_queue_mutex_);
+      b_shutdown_map_update_thread_ = true;
+    }
+    map_update_queue_cv_.notify_one();
+    map_update_thread_.join();
+  }
+}
 
 // Spinners/subscribers
 // ----------------------------------------------------------
@@ -113,6 +142,12 @@ void Locus::setLidarSubscriber(ros::NodeHandle& _nh) {
 bool Locus::Initialize(const ros::NodeHandle& n, bool from_log) {
   ROS_INFO("Locus::Initialize");
   name_ = ros::names::append(n.getNamespace(), "locus");
+  // Apportion the shared thread budget before the sub-modules read their
+  // num_threads parameters
+  if (!ApplyThreadBudget(n)) {
+    ROS_ERROR("%s: Failed to apply thread budget.", name_.c_str());
+    return false;
+  }
   if (!filter_.Initialize(n)) {
     ROS_ERROR("%s: Failed to initialize point cloud filter.", name_.c_str());
     return false;
@@ -152,6 +187,64 @@ bool Locus::Initialize(const ros::NodeHandle& n, bool from_log) {
   last_refresh_pose_ = localization_.GetIntegratedEstimate();
   latest_pose_ = localization_.GetIntegratedEstimate();
   latest_odom_stamp_ = ros::Time(0);
+  if (b_pipelined_execution_) {
+    ROS_INFO("Enabling pipelined execution of LidarCallback");
+    registration_thread_ = std::thread(&Locus::RegistrationThread, this);
+  }
+  if (b_async_map_update_) {
+    ROS_INFO("Enabling asynchronous map updates");
+    map_update_thread_ = std::thread(&Locus::MapUpdateThread, this);
+  }
+  return true;
+}
+
+bool Locus::ApplyThreadBudget(const ros::NodeHandle& n) {
+  bool b_enforce_thread_budget;
+  int total_threads;
+  if (!pu::Get("thread_budget/b_enforce_thread_budget",
+               b_enforce_thread_budget))
+    return false;
+  if (!pu::Get("thread_budget/total_threads", total_threads))
+    return false;
+  if (!b_enforce_thread_budget)
+    return true;
+
+  int total = total_threads;
+  if (total <= 0)
+    total = static_cast<int>(std::thread::hardware_concurrency());
+  if (total <= 0)
+    total = 1;
+
+  int odometry_threads, localization_threads, mapper_threads;
+  if (!pu::Get("icp/num_threads", odometry_threads))
+    return false;
+  if (!pu::Get("localization/num_threads", localization_threads))
+    return false;
+  if (!pu::Get("mapper/num_threads", mapper_threads))
+    return false;
+
+  // The mapper inserts keyframes concurrently with registration, so cap it
+  // at a quarter of the budget and leave the rest to the scan pipeline
+  mapper_threads = std::min(mapper_threads, std::max(1, total / 4));
+  // Odometry and localization registration run one at a time on a scan, so
+  // both stages can use the full remaining slice
+  const int registration_threads = std::max(1, total - mapper_threads);
+  odometry_threads = std::min(odometry_threads, registration_threads);
+  localization_threads = std::min(localization_threads, registration_threads);
+
+  ros::NodeHandle nl(n);
+  nl.setParam("icp/num_threads", odometry_threads);
+  nl.setParam("localization/num_threads", localization_threads);
+  nl.setParam("mapper/num_threads", mapper_threads);
+
+  // Keep team sizes fixed so the OpenMP runtime reuses one pool of threads
+  // across the stages instead of resizing between regions
+  omp_set_dynamic(0);
+
+  ROS_INFO_STREAM("Locus::ApplyThreadBudget - total: "
+                  << total << ", odometry: " << odometry_threads
+                  << ", localization: " << localization_threads
+                  << ", mapper: " << mapper_threads);
   return true;
 }
 
@@ -192,11 +285,15 @@ bool Locus::LoadParameters(const ros::NodeHandle& n) {
     return false;
   if (!pu::Get("queues/odom_queue_size", odom_queue_size_))
     return false;
+  if (!pu::Get("queues/b_latest_scan_wins", b_latest_scan_wins_))
+    return false;
   if (!pu::Get("buffers/imu_buffer_size_limit", imu_buffer_size_limit_))
     return false;
   if (!pu::Get("buffers/odometry_buffer_size_limit",
                odometry_buffer_size_limit_))
     return false;
+  imu_buffer_.SetCapacity(imu_buffer_size_limit_);
+  odometry_buffer_.SetCapacity(odometry_buffer_size_limit_);
   if (!pu::Get("data_integration/mode", data_integration_mode_))
     return false;
   if (!pu::Get("b_enable_computation_time_profiling",
@@ -206,6 +303,12 @@ bool Locus::LoadParameters(const ros::NodeHandle& n) {
     return false;
   if (!pu::Get("gt_point_cloud_filename", gt_point_cloud_filename_))
     return false;
+  if (!pu::Get("gt_chunk_size", gt_chunk_size_))
+    return false;
+  if (!pu::Get("b_gt_load_around_start_pose", b_gt_load_around_start_pose_))
+    return false;
+  if (!pu::Get("gt_load_radius", gt_load_radius_))
+    return false;
   if (!pu::Get("publish_diagnostics", publish_diagnostics_))
     return false;
   if (!pu::Get("window_local_mapping_type", window_local_mapping_type_))
@@ -257,14 +360,61 @@ bool Locus::LoadParameters(const ros::NodeHandle& n) {
   if (!pu::Get("points_to_process_in_callback", points_to_process_in_callback_))
     return false;
 
+  // Scan logging
+  if (!pu::Get("scan_log/b_log_scans", b_log_scans_))
+    return false;
+  if (!pu::Get("scan_log/path", scan_log_path_))
+    return false;
+  if (b_log_scans_ && !scan_log_writer_.Open(scan_log_path_)) {
+    ROS_ERROR_STREAM("Failed to open scan log " << scan_log_path_);
+    return false;
+  }
+
+  // Latency controller
+  if (!pu::Get("latency_controller/b_enable_latency_controller",
+               b_enable_latency_controller_))
+    return false;
+  if (!pu::Get("latency_controller/target_callback_duration",
+               target_callback_duration_))
+    return false;
+  if (!pu::Get("latency_controller/deadband_ratio", latency_deadband_ratio_))
+    return false;
+  if (!pu::Get("latency_controller/min_registration_iterations",
+               min_registration_iterations_))
+    return false;
+  // The localization iteration cap doubles as the controller's upper bound
+  if (!pu::Get("localization/iterations", baseline_registration_iterations_))
+    return false;
+  current_registration_iterations_ = baseline_registration_iterations_;
+  smoothed_callback_duration_ = target_callback_duration_;
+
   // Dynamic Switching
   if (!pu::Get("sensor_health_timeout", sensor_health_timeout_))
     return false;
 
+  // Pipelined execution
+  if (!pu::Get("pipeline/b_pipelined_execution", b_pipelined_execution_))
+    return false;
+  if (!pu::Get("pipeline/registration_queue_size", registration_queue_size_))
+    return false;
+
+  // Asynchronous map updates
+  if (!pu::Get("b_async_map_update", b_async_map_update_))
+    return false;
+
+  // Fixed-frame registration
+  if (!pu::Get("b_registration_in_fixed_frame", b_registration_in_fixed_frame_))
+    return false;
+
   ROS_INFO_STREAM(
       "b_integrate_interpolated_odom_: " << b_integrate_interpolated_odom_);
 
-  mapper_ = mapperFabric(window_local_mapping_type_);
+  // The voxel-hash mapper lives in this package; every other type comes
+  // from the point_cloud_mapper factory
+  if (window_local_mapping_type_ == "voxel_hash_mapper")
+    mapper_ = IPointCloudMapper::Ptr(new VoxelHashMapper());
+  else
+    mapper_ = mapperFabric(window_local_mapping_type_);
   mapper_->SetBoxFilterSize(box_filter_size_);
   mapper_->SetupNumberThreads(mapper_threads_);
 
@@ -347,9 +497,46 @@ bool Locus::CreatePublishers(const ros::NodeHandle& n) {
       nl.advertise<diagnostic_msgs::DiagnosticArray>("/diagnostics", 10, false);
   time_difference_pub_ =
       nl.advertise<std_msgs::Float64>("time_difference", 10, false);
+  skipped_scans_pub_ =
+      nl.advertise<std_msgs::Int32>("skipped_scans", 10, false);
+  if (b_enable_computation_time_profiling_) {
+    profiling_pub_ =
+        nl.advertise<diagnostic_msgs::DiagnosticArray>("profiling", 10, false);
+    profiling_pub_timer_ = nl_.createTimer(
+        ros::Duration(1.0), &Locus::PublishProfilingSummaries, this);
+  }
   return true;
 }
 
+void Locus::PublishProfilingSummaries(const ros::TimerEvent& ev) {
+  diagnostic_msgs::DiagnosticArray diagnostic_array;
+  for (size_t stage = 0; stage < StageProfiler::NUM_STAGES; stage++) {
+    const StageProfiler::Summary summary = stage_profiler_.Snapshot(stage);
+    diagnostic_msgs::DiagnosticStatus status;
+    status.name =
+        std::string("locus_profiling/") + StageProfiler::StageName(stage);
+    status.level = diagnostic_msgs::DiagnosticStatus::OK;
+    status.hardware_id = name_;
+    diagnostic_msgs::KeyValue kv;
+    kv.key = "count";
+    kv.value = std::to_string(summary.count);
+    status.values.push_back(kv);
+    kv.key = "p50_ms";
+    kv.value = std::to_string(summary.p50 * 1.0e3);
+    status.values.push_back(kv);
+    kv.key = "p95_ms";
+    kv.value = std::to_string(summary.p95 * 1.0e3);
+    status.values.push_back(kv);
+    kv.key = "p99_ms";
+    kv.value = std::to_string(summary.p99 * 1.0e3);
+    status.values.push_back(kv);
+    diagnostic_array.status.push_back(status);
+  }
+  diagnostic_array.header.stamp = ros::Time::now();
+  diagnostic_array.header.frame_id = name_;
+  profiling_pub_.publish(diagnostic_array);
+}
+
 // Callbacks
 // ---------------------------------------------------------------------
 
@@ -362,10 +549,6 @@ void Locus::ImuCallback(const ImuConstPtr& imu_msg) {
     ROS_WARN("Throwing IMU message as it contains NANS");
     return;
   }
-  std::lock_guard<std::mutex> lock(imu_buffer_mutex_);
-  if (CheckBufferSize(imu_buffer_) > imu_buffer_size_limit_) {
-    imu_buffer_.erase(imu_buffer_.begin());
-  }
   if (!InsertMsgInBuffer(imu_msg, imu_buffer_)) {
     ROS_WARN("Unable to store IMU message in buffer");
   }
@@ -374,10 +557,6 @@ void Locus::ImuCallback(const ImuConstPtr& imu_msg) {
 void Locus::OdometryCallback(const OdometryConstPtr& odometry_msg) {
   last_reception_time_odom_ = ros::Time::now();
   if (!b_integrate_interpolated_odom_) {
-    std::lock_guard<std::mutex> lock(odometry_buffer_mutex_);
-    if (CheckBufferSize(odometry_buffer_) > odometry_buffer_size_limit_) {
-      odometry_buffer_.erase(odometry_buffer_.begin());
-    }
     if (!InsertMsgInBuffer(odometry_msg, odometry_buffer_)) {
       ROS_WARN("Unable to store Odometry message in buffer");
     }
@@ -394,7 +573,11 @@ void Locus::OdometryCallback(const OdometryConstPtr& odometry_msg) {
       tf2_ros_odometry_buffer_.setTransform(
           tf_stamped, tf_buffer_authority_, false);
     }
-    latest_odom_stamp_ = odometry_msg->header.stamp;
+    {
+      std::lock_guard<std::mutex> lock(odom_arrival_mutex_);
+      latest_odom_stamp_ = odometry_msg->header.stamp;
+    }
+    odom_arrival_cv_.notify_all();
   }
 }
 
@@ -423,19 +606,129 @@ void Locus::CheckMsgDropRate(const PointCloudF::ConstPtr& msg) {
 }
 
 void Locus::LidarCallback(const PointCloudF::ConstPtr& msg) {
-  if (b_enable_computation_time_profiling_) {
-    lidar_callback_start_ = ros::Time::now();
+  ros::Time callback_start = ros::Time::now();
+
+  CheckMsgDropRate(msg);
+
+  if (b_latest_scan_wins_ && !lidar_queue_.isEmpty()) {
+    // A newer scan is already waiting on the dedicated lidar queue: skip
+    // this one so the spinner drains to the freshest data. The motion
+    // across skipped scans is recovered by IntegrateSensors, which
+    // integrates the sensor buffers from the last processed stamp
+    skipped_scans_count_++;
+    std_msgs::Int32 skipped_msg;
+    skipped_msg.data = skipped_scans_count_;
+    skipped_scans_pub_.publish(skipped_msg);
+    return;
   }
 
-  if (b_adaptive_input_voxelization_) {
+  // The latency controller owns the voxel leaf when enabled, so the
+  // open-loop point-count heuristic is bypassed
+  if (b_adaptive_input_voxelization_ && !b_enable_latency_controller_) {
     ApplyAdaptiveInputVoxelization(msg);
   }
 
-  CheckMsgDropRate(msg);
+  if (b_pipelined_execution_) {
+    // Filter here on the lidar spinner thread so scan N+1 can be filtered
+    // while the registration thread is still working on scan N. Each bundle
+    // carries its own filtered cloud as the two stages run concurrently
+    PointCloudF::Ptr msg_filtered = cloud_pool_.Acquire();
+    {
+      ScopedStageTimer timer(Profiler(), StageProfiler::FILTER);
+      filter_.Filter(msg, msg_filtered, b_is_open_space_);
+    }
+    {
+      std::lock_guard<std::mutex> lock(registration_queue_mutex_);
+      if (registration_queue_.size() >=
+          static_cast<size_t>(registration_queue_size_)) {
+        // Bounded queue: drop the oldest scan so registration always
+        // consumes the freshest data when it falls behind
+        registration_queue_.pop_front();
+        scans_dropped_++;
+      }
+      registration_queue_.push_back({msg, msg_filtered, callback_start});
+    }
+    registration_queue_cv_.notify_one();
+    return;
+  }
+
+  // A distinct filtered cloud is handed out per scan since odometry keeps a
+  // handle on it across frames (zero-copy handoff); the pool recycles the
+  // storage once odometry releases it
+  PointCloudF::Ptr msg_filtered = cloud_pool_.Acquire();
+  {
+    ScopedStageTimer timer(Profiler(), StageProfiler::FILTER);
+    filter_.Filter(msg, msg_filtered, b_is_open_space_);
+  }
+  ProcessScanRegistration(msg, msg_filtered, callback_start);
+}
+
+void Locus::RegistrationThread() {
+  while (true) {
+    ScanBundle bundle;
+    {
+      std::unique_lock<std::mutex> lock(registration_queue_mutex_);
+      registration_queue_cv_.wait(lock, [this] {
+        return b_shutdown_registration_thread_ || !registration_queue_.empty();
+      });
+      if (b_shutdown_registration_thread_ && registration_queue_.empty()) {
+        break;
+      }
+      bundle = registration_queue_.front();
+      registration_queue_.pop_front();
+    }
+    ProcessScanRegistration(
+        bundle.msg, bundle.msg_filtered, bundle.callback_start);
+  }
+}
+
+void Locus::MapUpdateThread() {
+  while (true) {
+    MapUpdateTask task;
+    {
+      std::unique_lock<std::mutex> lock(map_update_queue_mutex_);
+      map_update_queue_cv_.wait(lock, [this] {
+        return b_shutdown_map_update_thread_ || !map_update_queue_.empty();
+      });
+      if (b_shutdown_map_update_thread_ && map_update_queue_.empty()) {
+        break;
+      }
+      task = map_update_queue_.front();
+      map_update_queue_.pop_front();
+    }
+    ScopedStageTimer timer(Profiler(), StageProfiler::MAP_INSERT);
+    std::lock_guard<std::mutex> lock(mapper_mutex_);
+    mapper_->UpdateCurrentPose(task.pose);
+    mapper_->InsertPoints(task.points_fixed, mapper_unused_out_.get());
+    localization_.SignalMapUpdate();
+    if (task.b_refresh)
+      mapper_->Refresh(task.pose);
+    if (task.b_publish_map)
+      mapper_->PublishMap();
+  }
+}
 
+void Locus::ProcessScanRegistration(const PointCloudF::ConstPtr& msg,
+                                    const PointCloudF::Ptr& msg_filtered,
+                                    const ros::Time& callback_start) {
   ros::Time stamp = pcl_conversions::fromPCL(msg->header.stamp);
 
+  if (b_log_scans_) {
+    sensor_msgs::Imu imu_msg;
+    nav_msgs::Odometry odometry_msg;
+    double unused_time_diff;
+    const bool b_has_imu =
+        imu_buffer_.GetClosest(stamp.toSec(), &imu_msg, &unused_time_diff);
+    const bool b_has_odometry = odometry_buffer_.GetClosest(
+        stamp.toSec(), &odometry_msg, &unused_time_diff);
+    scan_log_writer_.Append(*msg_filtered,
+                            stamp.toSec(),
+                            b_has_imu ? &imu_msg : nullptr,
+                            b_has_odometry ? &odometry_msg : nullptr);
+  }
+
   if (data_integration_mode_ != 0) {
+    ScopedStageTimer timer(Profiler(), StageProfiler::PRIOR_INTEGRATION);
     if (!IntegrateSensors(stamp)) {
       if (!b_process_pure_lo_) {
         return;
@@ -447,10 +740,14 @@ void Locus::LidarCallback(const PointCloudF::ConstPtr& msg) {
     b_process_pure_lo_prev_ = b_process_pure_lo_;
   }
 
-  filter_.Filter(msg, msg_filtered_, b_is_open_space_); // TODO: remove
-  odometry_.SetLidar(*msg_filtered_);
+  odometry_.SetLidar(msg_filtered);
 
-  if (!odometry_.UpdateEstimate()) {
+  bool b_odometry_updated;
+  {
+    ScopedStageTimer timer(Profiler(), StageProfiler::SCAN_TO_SCAN_ICP);
+    b_odometry_updated = odometry_.UpdateEstimate();
+  }
+  if (!b_odometry_updated) {
     b_add_first_scan_to_key_ = true;
   }
 
@@ -461,8 +758,12 @@ void Locus::LidarCallback(const PointCloudF::ConstPtr& msg) {
 
   if (b_add_first_scan_to_key_ && !b_run_with_gt_point_cloud_) {
     localization_.TransformPointsToFixedFrame(*msg, msg_transformed_.get());
-    mapper_->UpdateCurrentPose(localization_.GetIntegratedEstimate());
-    mapper_->InsertPoints(msg_transformed_, mapper_unused_fixed_.get());
+    {
+      std::lock_guard<std::mutex> lock(mapper_mutex_);
+      mapper_->UpdateCurrentPose(localization_.GetIntegratedEstimate());
+      mapper_->InsertPoints(msg_transformed_, mapper_unused_fixed_.get());
+      localization_.SignalMapUpdate();
+    }
     localization_.UpdateTimestamp(stamp);
     localization_.PublishPoseNoUpdate();
     b_add_first_scan_to_key_ = false;
@@ -473,20 +774,51 @@ void Locus::LidarCallback(const PointCloudF::ConstPtr& msg) {
 
   localization_.MotionUpdate(odometry_.GetIncrementalEstimate());
 
-  localization_.TransformPointsToFixedFrame(*msg_filtered_,
+  localization_.TransformPointsToFixedFrame(*msg_filtered,
                                             msg_transformed_.get());
 
-  if (!mapper_->ApproxNearestNeighbors(*msg_transformed_,
-                                       msg_neighbors_.get())) {
-    ROS_WARN("mapper_->ApproxNearestNeighbors returned false");
-    return;
+  {
+    ScopedStageTimer timer(Profiler(), StageProfiler::NN_EXTRACTION);
+    std::lock_guard<std::mutex> lock(mapper_mutex_);
+    if (!mapper_->ApproxNearestNeighbors(*msg_transformed_,
+                                         msg_neighbors_.get())) {
+      ROS_WARN("mapper_->ApproxNearestNeighbors returned false");
+      return;
+    }
   }
 
-  localization_.TransformPointsToSensorFrame(*msg_neighbors_,
-                                             msg_neighbors_.get());
+  // Only materialize the aligned base-frame cloud when someone is listening
+  PointCloudF* aligned_out =
+      base_frame_pcld_pub_.getNumSubscribers() > 0 ? msg_base_.get() : nullptr;
+
+  {
+    ScopedStageTimer timer(Profiler(), StageProfiler::SCAN_TO_MAP_ICP);
+    if (b_registration_in_fixed_frame_) {
+      // The fixed-frame query was already materialized for the neighbor
+      // search, and the neighborhood comes out of the map in the fixed
+      // frame: register them directly instead of rewriting the (larger)
+      // neighborhood into the sensor frame first. The scan-to-scan
+      // covariances are expressed in the sensor frame, so they are not
+      // passed along here
+      localization_.MeasurementUpdate(
+          msg_transformed_, msg_neighbors_, aligned_out);
+    } else {
+      localization_.TransformPointsToSensorFrame(*msg_neighbors_,
+                                                 msg_neighbors_.get());
+
+      // Pass along the covariances the scan-to-scan stage derived from this
+      // scan's normals so localization does not convert them a second time
+      localization_.MeasurementUpdate(msg_filtered,
+                                      msg_neighbors_,
+                                      aligned_out,
+                                      odometry_.GetQueryCovariances());
+    }
+  }
 
-  localization_.MeasurementUpdate(
-      msg_filtered_, msg_neighbors_, msg_base_.get());
+  // msg_base_ is rewritten in place every scan, so subscribers get a copy
+  // rather than the shared buffer
+  if (aligned_out != nullptr)
+    base_frame_pcld_pub_.publish(boost::make_shared<PointCloudF>(*msg_base_));
 
   auto diagnostics_localization = localization_.GetDiagnostics();
   if (diagnostics_localization.level == 0) {
@@ -527,29 +859,55 @@ void Locus::LidarCallback(const PointCloudF::ConstPtr& msg) {
                       << delta.translation.Norm() << " and rotation "
                       << 2 * acos(q.w()) * 180.0 / M_PI << " deg");
     localization_.MotionUpdate(gu::Transform3::Identity());
-    localization_.TransformPointsToFixedFrame(*msg, msg_fixed_.get());
-    mapper_->UpdateCurrentPose(localization_.GetIntegratedEstimate());
-    mapper_->InsertPoints(msg_fixed_, mapper_unused_out_.get());
+    bool b_refresh = false;
+    bool b_publish = false;
     if (b_publish_map_) {
       counter_++;
       if (counter_ == map_publishment_meters_) {
-        if (b_enable_msw_)
-          mapper_->Refresh(current_pose);
-        mapper_->PublishMap();
+        b_refresh = b_enable_msw_;
+        b_publish = true;
         counter_ = 0;
       }
     }
+    if (b_async_map_update_) {
+      // Transform to the fixed frame with the current pose, then hand the
+      // insertion, refresh and map publishing to the map update thread so
+      // keyframe scans do not stall the odometry path
+      PointCloudF::Ptr points_fixed = cloud_pool_.Acquire();
+      localization_.TransformPointsToFixedFrame(*msg, points_fixed.get());
+      {
+        std::lock_guard<std::mutex> lock(map_update_queue_mutex_);
+        map_update_queue_.push_back(
+            {points_fixed, current_pose, b_refresh, b_publish});
+      }
+      map_update_queue_cv_.notify_one();
+    } else {
+      ScopedStageTimer timer(Profiler(), StageProfiler::MAP_INSERT);
+      localization_.TransformPointsToFixedFrame(*msg, msg_fixed_.get());
+      std::lock_guard<std::mutex> lock(mapper_mutex_);
+      mapper_->UpdateCurrentPose(localization_.GetIntegratedEstimate());
+      mapper_->InsertPoints(msg_fixed_, mapper_unused_out_.get());
+      localization_.SignalMapUpdate();
+      if (b_refresh)
+        mapper_->Refresh(current_pose);
+      if (b_publish)
+        mapper_->PublishMap();
+    }
     last_keyframe_pose_ = current_pose;
   }
 
   if (b_enable_computation_time_profiling_) {
     auto lidar_callback_end = ros::Time::now();
-    auto lidar_callback_duration = lidar_callback_end - lidar_callback_start_;
+    auto lidar_callback_duration = lidar_callback_end - callback_start;
     auto lidar_callback_duration_msg = std_msgs::Float64();
     lidar_callback_duration_msg.data = float(lidar_callback_duration.toSec());
     lidar_callback_duration_pub_.publish(lidar_callback_duration_msg);
   }
 
+  if (b_enable_latency_controller_) {
+    ApplyLatencyController((ros::Time::now() - callback_start).toSec());
+  }
+
   if (publish_diagnostics_) {
     diagnostic_msgs::DiagnosticArray diagnostic_array;
     diagnostic_array.status.push_back(diagnostics_odometry);
@@ -742,9 +1100,135 @@ bool Locus::CheckNans(const Imu& imu_msg) {
       std::isnan(imu_msg.linear_acceleration.z));
 }
 
+bool Locus::StreamGTPointCloud(const std::string& filename) {
+  pcl::PCDReader pcd_reader;
+  pcl::PCLPointCloud2 header;
+  Eigen::Vector4f origin;
+  Eigen::Quaternionf orientation;
+  int pcd_version, data_type;
+  unsigned int data_idx;
+  if (pcd_reader.readHeader(filename,
+                            header,
+                            origin,
+                            orientation,
+                            pcd_version,
+                            data_type,
+                            data_idx) < 0) {
+    ROS_ERROR_STREAM("Failed to read PCD header from " << filename);
+    return false;
+  }
+  // Only uncompressed binary data can be sliced in place
+  if (data_type != 1) {
+    return false;
+  }
+
+  const int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    ROS_ERROR_STREAM("Failed to open " << filename);
+    return false;
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) < 0) {
+    ROS_ERROR_STREAM("Failed to stat " << filename);
+    close(fd);
+    return false;
+  }
+  const size_t file_size = static_cast<size_t>(file_stat.st_size);
+  unsigned char* mapped = static_cast<unsigned char*>(
+      mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0));
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    ROS_ERROR_STREAM("Failed to memory-map " << filename);
+    return false;
+  }
+  madvise(mapped, file_size, MADV_SEQUENTIAL);
+
+  size_t point_step = 0;
+  for (const auto& field : header.fields) {
+    const size_t field_end = field.offset +
+        pcl::getFieldSize(field.datatype) * field.count;
+    point_step = std::max(point_step, field_end);
+  }
+  const size_t total_points =
+      static_cast<size_t>(header.width) * static_cast<size_t>(header.height);
+
+  // The chunk slices read straight from the mapping, so a truncated or
+  // header-inconsistent file must be rejected here: touching pages past
+  // the end of the file would raise SIGBUS instead of an error
+  if (data_idx + total_points * point_step > file_size) {
+    ROS_ERROR_STREAM("PCD data section of " << filename << " is truncated: "
+                                            << "header promises "
+                                            << total_points << " points of "
+                                            << point_step << " bytes at offset "
+                                            << data_idx << " in a " << file_size
+                                            << " byte file");
+    munmap(mapped, file_size);
+    return false;
+  }
+  const size_t chunk_points = static_cast<size_t>(std::max(1, gt_chunk_size_));
+
+  // Crop region around the fiducial-calibrated start pose, applied per
+  // chunk so the full cloud is never materialized
+  const Eigen::Vector3d center =
+      localization_.GetIntegratedEstimate().translation.Eigen();
+  const double radius_sq = gt_load_radius_ * gt_load_radius_;
+
+  PointCloudF::Ptr unused(new PointCloudF);
+  pcl::PCLPointCloud2 chunk_blob;
+  chunk_blob.fields = header.fields;
+  chunk_blob.point_step = point_step;
+  chunk_blob.height = 1;
+  chunk_blob.is_dense = header.is_dense;
+
+  size_t inserted_points = 0;
+  for (size_t start = 0; start < total_points; start += chunk_points) {
+    const size_t count = std::min(chunk_points, total_points - start);
+    chunk_blob.width = count;
+    chunk_blob.row_step = count * point_step;
+    const unsigned char* chunk_start =
+        mapped + data_idx + start * point_step;
+    chunk_blob.data.assign(chunk_start, chunk_start + count * point_step);
+
+    PointCloudF::Ptr chunk(new PointCloudF);
+    pcl::fromPCLPointCloud2(chunk_blob, *chunk);
+
+    if (b_gt_load_around_start_pose_) {
+      size_t kept = 0;
+      for (size_t i = 0; i < chunk->size(); i++) {
+        const PointF& p = chunk->points[i];
+        const double dx = p.x - center.x();
+        const double dy = p.y - center.y();
+        const double dz = p.z - center.z();
+        if (dx * dx + dy * dy + dz * dz <= radius_sq)
+          chunk->points[kept++] = p;
+      }
+      chunk->resize(kept);
+      chunk->width = kept;
+      chunk->height = 1;
+    }
+
+    if (!chunk->empty()) {
+      mapper_->InsertPoints(chunk, unused.get());
+      inserted_points += chunk->size();
+    }
+  }
+  munmap(mapped, file_size);
+  localization_.SignalMapUpdate();
+  ROS_INFO_STREAM("Streamed " << inserted_points << " of " << total_points
+                              << " GT points into the map in chunks of "
+                              << chunk_points);
+  return true;
+}
+
 void Locus::InitWithGTPointCloud(const std::string filename) {
   ROS_INFO_STREAM("Generating point cloud ground truth using point cloud from "
                   << filename);
+  // Stream binary PCDs in bounded chunks; fall back to the one-shot reader
+  // for formats that cannot be sliced in place
+  if (StreamGTPointCloud(filename)) {
+    ROS_INFO("Completed addition of GT point cloud to map");
+    return;
+  }
   // Read ground truth from file
   pcl::PCDReader pcd_reader;
   PointCloudF gt_point_cloud;
@@ -753,6 +1237,7 @@ void Locus::InitWithGTPointCloud(const std::string filename) {
   // Create octree map to select only the parts needed
   PointCloudF::Ptr unused(new PointCloudF);
   mapper_->InsertPoints(gt_pc_ptr, unused.get());
+  localization_.SignalMapUpdate();
   ROS_INFO("Completed addition of GT point cloud to map");
   mapper_->PublishMap();
 }
@@ -809,6 +1294,48 @@ void Locus::ApplyAdaptiveInputVoxelization(const PointCloudF::ConstPtr& msg) {
   dchange_voxel_pub_.publish(change_voxel_ros);
 }
 
+void Locus::ApplyLatencyController(double callback_duration) {
+  // Smooth the measurement so a single slow scan does not thrash the
+  // actuators
+  smoothed_callback_duration_ =
+      0.2 * callback_duration + 0.8 * smoothed_callback_duration_;
+
+  const double upper =
+      target_callback_duration_ * (1.0 + latency_deadband_ratio_);
+  const double lower =
+      target_callback_duration_ * (1.0 - latency_deadband_ratio_);
+
+  if (smoothed_callback_duration_ > upper) {
+    // Over deadline: coarsen the input voxel first since it cuts every
+    // downstream stage, then shed registration iterations
+    if (double_param.value < 5.0) {
+      double_param.value = std::min(5.0, double_param.value * 1.1);
+      std_msgs::Float64 voxel_leaf;
+      voxel_leaf.data = double_param.value;
+      change_leaf_size_pub_.publish(voxel_leaf);
+    } else if (current_registration_iterations_ >
+               min_registration_iterations_) {
+      current_registration_iterations_ =
+          std::max(min_registration_iterations_,
+                   (3 * current_registration_iterations_) / 4);
+      localization_.SetMaximumIterations(current_registration_iterations_);
+    }
+  } else if (smoothed_callback_duration_ < lower) {
+    // Headroom: restore registration quality first, then refine the input
+    if (current_registration_iterations_ < baseline_registration_iterations_) {
+      current_registration_iterations_ =
+          std::min(baseline_registration_iterations_,
+                   current_registration_iterations_ + 1);
+      localization_.SetMaximumIterations(current_registration_iterations_);
+    } else if (double_param.value > 0.01) {
+      double_param.value = std::max(0.01, double_param.value * 0.95);
+      std_msgs::Float64 voxel_leaf;
+      voxel_leaf.data = double_param.value;
+      change_leaf_size_pub_.publish(voxel_leaf);
+    }
+  }
+}
+
 Eigen::Matrix3d Locus::GetImuDelta() {
   return imu_quaternion_change_.normalized().toRotationMatrix();
 }
@@ -834,50 +1361,24 @@ Eigen::Matrix3d Locus::GetImuYawDelta() {
 
 template <typename T1, typename T2>
 bool Locus::InsertMsgInBuffer(const T1& msg, T2& buffer) {
-  auto initial_size = buffer.size();
-  auto current_time = msg->header.stamp.toSec();
-  buffer.insert({current_time, *msg});
-  auto final_size = buffer.size();
-  if (final_size == (initial_size + 1)) {
-    return true;
-  } else {
-    return false;
-  }
+  // Lock-free single-producer insertion; when the ring is full the oldest
+  // entry is overwritten so no explicit size management is needed
+  buffer.Insert(*msg);
+  return true;
 }
 
 template <typename T>
 int Locus::CheckBufferSize(const T& buffer) const {
-  return buffer.size();
+  return buffer.Size();
 }
 
 template <typename T1, typename T2>
 bool Locus::GetMsgAtTime(const ros::Time& stamp,
                          T1& msg,
                          const T2& buffer) const {
-  if (buffer.size() == 0) {
-    return false;
-  }
-  auto itrTime = buffer.lower_bound(stamp.toSec());
-  auto time2 = itrTime->first;
   double time_diff;
-  if (itrTime == buffer.begin()) {
-    msg = itrTime->second;
-    time_diff = itrTime->first - stamp.toSec();
-    ROS_WARN("itrTime points to buffer begin");
-  } else if (itrTime == buffer.end()) {
-    itrTime--;
-    msg = itrTime->second;
-    time_diff = stamp.toSec() - itrTime->first;
-    ROS_WARN("itrTime points to buffer end");
-  } else {
-    double time1 = std::prev(itrTime, 1)->first;
-    if (time2 - stamp.toSec() < stamp.toSec() - time1) {
-      msg = itrTime->second;
-      time_diff = time2 - stamp.toSec();
-    } else {
-      msg = std::prev(itrTime, 1)->second;
-      time_diff = stamp.toSec() - time1;
-    }
+  if (!buffer.GetClosest(stamp.toSec(), &msg, &time_diff)) {
+    return false;
   }
   if (fabs(time_diff) > 0.1) {
     ROS_WARN("fabs(time_diff) > 0.1 : returing false");
@@ -925,13 +1426,10 @@ bool Locus::IntegrateSensors(const ros::Time& stamp) {
 
 bool Locus::IntegrateOdom(const ros::Time& stamp) {
   Odometry odometry_msg;
-  {
-    std::lock_guard<std::mutex> lock(odometry_buffer_mutex_);
-    if (!GetMsgAtTime(stamp, odometry_msg, odometry_buffer_)) {
-      ROS_WARN("Unable to retrieve odometry_msg from odometry_buffer_ "
-               "given lidar timestamp");
-      return false;
-    }
+  if (!GetMsgAtTime(stamp, odometry_msg, odometry_buffer_)) {
+    ROS_WARN("Unable to retrieve odometry_msg from odometry_buffer_ "
+             "given lidar timestamp");
+    return false;
   }
   if (!b_odometry_has_been_received_) {
     ROS_WARN("Integrating odom");
@@ -956,16 +1454,19 @@ bool Locus::IntegrateInterpolatedOdom(const ros::Time& stamp) {
   bool have_odom_transform = false;
   geometry_msgs::TransformStamped t;
 
-  auto wait_for_transform_start_time = ros::Time::now();
   ros::Time latest_odom_stamp = latest_odom_stamp_;
-  while (latest_odom_stamp < stamp) {
+  if (latest_odom_stamp < stamp) {
+    // Block until OdometryCallback signals that odometry has caught up with
+    // the lidar stamp instead of polling on a 10 ms sleep
+    std::unique_lock<std::mutex> lock(odom_arrival_mutex_);
+    bool b_caught_up = odom_arrival_cv_.wait_for(
+        lock,
+        std::chrono::duration<double>(wait_for_odom_transform_timeout_),
+        [this, &stamp] { return ros::Time(latest_odom_stamp_) >= stamp; });
     latest_odom_stamp = latest_odom_stamp_;
-    if ((ros::Time::now() - wait_for_transform_start_time).toSec() >
-        wait_for_odom_transform_timeout_) {
+    if (!b_caught_up) {
       ROS_WARN("latest_odom_stamp < stamp");
-      break;
     }
-    ros::Duration(0.01).sleep();
   }
 
   if (latest_odom_stamp < stamp && latest_odom_stamp > previous_stamp_) {
@@ -1016,13 +1517,10 @@ bool Locus::IntegrateInterpolatedOdom(const ros::Time& stamp) {
 
 bool Locus::IntegrateImu(const ros::Time& stamp) {
   Imu imu_msg;
-  {
-    std::lock_guard<std::mutex> lock(imu_buffer_mutex_);
-    if (!GetMsgAtTime(stamp, imu_msg, imu_buffer_)) {
-      ROS_WARN("Unable to retrieve imu_msg from imu_buffer_ "
-               "given lidar timestamp");
-      return false;
-    }
+  if (!GetMsgAtTime(stamp, imu_msg, imu_buffer_)) {
+    ROS_WARN("Unable to retrieve imu_msg from imu_buffer_ "
+             "given lidar timestamp");
+    return false;
   }
   auto imu_quaternion = GetImuQuaternion(imu_msg);
   if (!b_imu_has_been_received_) {
@@ -0,0 +1,234 @@
+/*
+Authors:
+  - Matteo Palieri    (matteo.palieri@jpl.nasa.gov)
+  - Benjamin Morrell  (benjamin.morrell@jpl.nasa.gov)
+*/
+
+#include <locus/VoxelHashMapper.h>
+
+#include <cmath>
+#include <limits>
+
+#include <omp.h>
+
+#include <parameter_utils/ParameterUtils.h>
+
+namespace pu = parameter_utils;
+namespace gu = geometry_utils;
+
+VoxelHashMapper::VoxelHashMapper()
+  : resolution_(0.5),
+    max_points_per_voxel_(1),
+    box_filter_size_(20),
+    num_threads_(1),
+    cells_per_axis_(0),
+    coord_mask_(0),
+    axis_shift_(0),
+    window_half_cells_(0),
+    center_coord_(0, 0, 0) {}
+
+VoxelHashMapper::~VoxelHashMapper() {}
+
+bool VoxelHashMapper::Initialize(const ros::NodeHandle& n) {
+  name_ = ros::names::append(n.getNamespace(), "VoxelHashMapper");
+
+  if (!LoadParameters(n)) {
+    ROS_ERROR("%s: Failed to load parameters.", name_.c_str());
+    return false;
+  }
+
+  if (!CreatePublishers(n)) {
+    ROS_ERROR("%s: Failed to create publishers.", name_.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+bool VoxelHashMapper::LoadParameters(const ros::NodeHandle& n) {
+  if (!pu::Get("frame_id/fixed", fixed_frame_id_))
+    return false;
+  if (!pu::Get("voxel_hash_mapper/resolution", resolution_))
+    return false;
+  if (!pu::Get("voxel_hash_mapper/max_points_per_voxel",
+               max_points_per_voxel_))
+    return false;
+
+  // Size the ring so the whole box filter window fits, rounded up to a
+  // power of two so the coordinate wrap is a mask. The accepted window
+  // spans 2 * window_half_cells_ + 1 cells per axis; the ring must cover
+  // at least that span or opposite window faces alias to the same slot
+  // and repossess each other's points
+  const int window_cells = static_cast<int>(
+      std::ceil(static_cast<double>(box_filter_size_) / resolution_));
+  window_half_cells_ = window_cells / 2 + 1;
+  cells_per_axis_ = 1;
+  axis_shift_ = 0;
+  while (cells_per_axis_ < 2 * window_half_cells_ + 1) {
+    cells_per_axis_ <<= 1;
+    axis_shift_++;
+  }
+  coord_mask_ = cells_per_axis_ - 1;
+  cells_.assign(static_cast<size_t>(cells_per_axis_) * cells_per_axis_ *
+                    cells_per_axis_,
+                Cell());
+
+  ROS_INFO_STREAM(name_ << ": " << cells_per_axis_ << "^3 cells at "
+                        << resolution_ << " m for a " << box_filter_size_
+                        << " m window");
+  return true;
+}
+
+bool VoxelHashMapper::CreatePublishers(const ros::NodeHandle& n) {
+  ros::NodeHandle nl(n);
+  map_pub_ = nl.advertise<PointCloudF>("voxel_hash_map", 10, false);
+  return true;
+}
+
+void VoxelHashMapper::SetBoxFilterSize(const int box_filter_size) {
+  box_filter_size_ = box_filter_size;
+}
+
+void VoxelHashMapper::SetupNumberThreads(const int number_of_threads) {
+  num_threads_ = number_of_threads;
+}
+
+Eigen::Vector3i VoxelHashMapper::VoxelCoord(const float x,
+                                            const float y,
+                                            const float z) const {
+  return Eigen::Vector3i(static_cast<int>(std::floor(x / resolution_)),
+                         static_cast<int>(std::floor(y / resolution_)),
+                         static_cast<int>(std::floor(z / resolution_)));
+}
+
+size_t VoxelHashMapper::SlotIndex(const Eigen::Vector3i& coord) const {
+  return (static_cast<size_t>(coord.x() & coord_mask_) << (2 * axis_shift_)) |
+      (static_cast<size_t>(coord.y() & coord_mask_) << axis_shift_) |
+      static_cast<size_t>(coord.z() & coord_mask_);
+}
+
+bool VoxelHashMapper::InWindow(const Eigen::Vector3i& coord) const {
+  return std::abs(coord.x() - center_coord_.x()) <= window_half_cells_ &&
+      std::abs(coord.y() - center_coord_.y()) <= window_half_cells_ &&
+      std::abs(coord.z() - center_coord_.z()) <= window_half_cells_;
+}
+
+bool VoxelHashMapper::InsertPoints(const PointCloudF::ConstPtr& points,
+                                   PointCloudF* incremental_points) {
+  if (incremental_points == NULL) {
+    ROS_ERROR("%s: Incremental points container is null.", name_.c_str());
+    return false;
+  }
+  incremental_points->clear();
+  incremental_points->header = points->header;
+
+  std::lock_guard<std::mutex> lock(cells_mutex_);
+  for (const auto& p : points->points) {
+    const Eigen::Vector3i coord = VoxelCoord(p.x, p.y, p.z);
+    if (!InWindow(coord))
+      continue;
+    Cell& cell = cells_[SlotIndex(coord)];
+    if (!cell.valid || cell.coord != coord) {
+      // Repossess the slot from whatever out-of-window voxel held it
+      cell.points.clear();
+      cell.coord = coord;
+      cell.valid = true;
+    }
+    if (static_cast<int>(cell.points.size()) < max_points_per_voxel_) {
+      cell.points.push_back(p);
+      incremental_points->push_back(p);
+    }
+  }
+  return true;
+}
+
+bool VoxelHashMapper::ApproxNearestNeighbors(const PointCloudF& points,
+                                             PointCloudF* neighbors) {
+  if (neighbors == NULL) {
+    ROS_ERROR("%s: Neighbors container is null.", name_.c_str());
+    return false;
+  }
+  neighbors->points.clear();
+
+  std::lock_guard<std::mutex> lock(cells_mutex_);
+  std::vector<PointF, Eigen::aligned_allocator<PointF>> found(points.size());
+  std::vector<uint8_t> has_neighbor(points.size(), 0);
+
+  int enable_omp = (1 < num_threads_);
+#pragma omp parallel for num_threads(num_threads_) if (enable_omp)
+  for (size_t i = 0; i < points.size(); i++) {
+    const PointF& query = points.points[i];
+    const Eigen::Vector3i coord = VoxelCoord(query.x, query.y, query.z);
+    float best_distance_sq = std::numeric_limits<float>::max();
+    for (int dx = -1; dx <= 1; dx++) {
+      for (int dy = -1; dy <= 1; dy++) {
+        for (int dz = -1; dz <= 1; dz++) {
+          const Eigen::Vector3i neighbor_coord(
+              coord.x() + dx, coord.y() + dy, coord.z() + dz);
+          // Eviction is lazy (slots are only repossessed on insert), so a
+          // cell that slid out of the window can still hold its points;
+          // skip it or queries would register against stale map geometry
+          if (!InWindow(neighbor_coord))
+            continue;
+          const Cell& cell = cells_[SlotIndex(neighbor_coord)];
+          if (!cell.valid || cell.coord != neighbor_coord)
+            continue;
+          for (const auto& p : cell.points) {
+            const float distance_sq = (p.x - query.x) * (p.x - query.x) +
+                (p.y - query.y) * (p.y - query.y) +
+                (p.z - query.z) * (p.z - query.z);
+            if (distance_sq < best_distance_sq) {
+              best_distance_sq = distance_sq;
+              found[i] = p;
+              has_neighbor[i] = 1;
+            }
+          }
+        }
+      }
+    }
+  }
+
+  for (size_t i = 0; i < points.size(); i++) {
+    if (has_neighbor[i])
+      neighbors->push_back(found[i]);
+  }
+  return neighbors->size() > 0;
+}
+
+void VoxelHashMapper::UpdateCurrentPose(const gu::Transform3& pose) {
+  std::lock_guard<std::mutex> lock(cells_mutex_);
+  const Eigen::Vector3d t = pose.translation.Eigen();
+  center_coord_ = VoxelCoord(static_cast<float>(t.x()),
+                             static_cast<float>(t.y()),
+                             static_cast<float>(t.z()));
+}
+
+void VoxelHashMapper::Refresh(const gu::Transform3& current_pose) {
+  // Out-of-window cells are evicted lazily when their slots are
+  // repossessed, so recentering is all the refresh there is
+  UpdateCurrentPose(current_pose);
+}
+
+void VoxelHashMapper::PublishMap() {
+  if (map_pub_.getNumSubscribers() == 0)
+    return;
+  PointCloudF::Ptr map(new PointCloudF());
+  {
+    std::lock_guard<std::mutex> lock(cells_mutex_);
+    for (const auto& cell : cells_) {
+      if (!cell.valid || !InWindow(cell.coord))
+        continue;
+      map->insert(map->end(), cell.points.begin(), cell.points.end());
+    }
+  }
+  map->header.frame_id = fixed_frame_id_;
+  map_pub_.publish(map);
+}
+
+void VoxelHashMapper::Reset() {
+  std::lock_guard<std::mutex> lock(cells_mutex_);
+  for (auto& cell : cells_) {
+    cell.valid = false;
+    cell.points.clear();
+  }
+}
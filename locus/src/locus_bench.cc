@@ -0,0 +1,282 @@
+/*
+Authors:
+  - Matteo Palieri    (matteo.palieri@jpl.nasa.gov)
+  - Benjamin Morrell  (benjamin.morrell@jpl.nasa.gov)
+*/
+
+// Offline deterministic replay benchmark. Feeds a directory of PCD scans
+// straight through PointCloudFilter::Filter, PointCloudOdometry and
+// PointCloudLocalization without ROS transport, so tuning changes can be
+// A/B compared without rosbag replay jitter. Parameters come from the
+// parameter server: load the same yaml files as a live run first, e.g.
+//
+//   rosparam load $(rospack find point_cloud_filter)/config/parameters.yaml
+//   (and filter/odometry/localization/mapper/locus settings likewise)
+//   rosrun locus locus_bench <pcd_directory|scan_log> [trajectory_output.csv]
+//
+// Scans are replayed in lexicographic filename order, or in recorded
+// order when the argument is a binary scan log written with
+// scan_log/b_log_scans (see ScanLogger.h). The report contains
+// per-stage p50/p95/p99 wall times, total replay time, and peak RSS; the
+// optional trajectory csv holds one pose per scan for regression
+// comparison against a reference run.
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <pcl/io/pcd_io.h>
+#include <ros/ros.h>
+#include <sys/resource.h>
+
+#include <frontend_utils/CommonStructs.h>
+#include <geometry_utils/Transform3.h>
+#include <locus/ScanLogger.h>
+#include <locus/StageProfiler.h>
+#include <locus/VoxelHashMapper.h>
+#include <parameter_utils/ParameterUtils.h>
+#include <point_cloud_filter/PointCloudFilter.h>
+#include <point_cloud_localization/PointCloudLocalization.h>
+#include <point_cloud_mapper/IPointCloudMapper.h>
+#include <point_cloud_mapper/settings.h>
+#include <point_cloud_odometry/PointCloudOdometry.h>
+
+namespace pu = parameter_utils;
+namespace gu = geometry_utils;
+
+namespace {
+
+void PrintStageSummary(StageProfiler& profiler, size_t stage) {
+  const StageProfiler::Summary summary = profiler.Snapshot(stage);
+  if (summary.count == 0)
+    return;
+  std::cout << "  " << StageProfiler::StageName(stage) << ": count "
+            << summary.count << ", p50 " << summary.p50 * 1.0e3 << " ms, p95 "
+            << summary.p95 * 1.0e3 << " ms, p99 " << summary.p99 * 1.0e3
+            << " ms" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  ros::init(argc, argv, "locus_bench");
+  ros::NodeHandle n("~");
+
+  if (argc < 2) {
+    std::cerr << "Usage: locus_bench <pcd_directory|scan_log> "
+                 "[trajectory_output.csv]"
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // A regular file is a binary scan log (see ScanLogger.h); a directory is
+  // replayed as sorted PCDs
+  const bool b_replay_log = boost::filesystem::is_regular_file(argv[1]);
+  ScanLogReader log_reader;
+  std::vector<std::string> scan_files;
+  if (b_replay_log) {
+    if (!log_reader.Open(argv[1])) {
+      std::cerr << "Failed to open scan log " << argv[1] << std::endl;
+      return EXIT_FAILURE;
+    }
+  } else {
+    // Lexicographic order keeps the replay deterministic across runs
+    for (boost::filesystem::directory_iterator it(argv[1]);
+         it != boost::filesystem::directory_iterator();
+         ++it) {
+      if (it->path().extension() == ".pcd")
+        scan_files.push_back(it->path().string());
+    }
+    std::sort(scan_files.begin(), scan_files.end());
+    if (scan_files.empty()) {
+      std::cerr << "No .pcd scans found in " << argv[1] << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  PointCloudFilter filter;
+  PointCloudOdometry odometry;
+  PointCloudLocalization localization;
+  if (!filter.Initialize(n) || !odometry.Initialize(n) ||
+      !localization.Initialize(n)) {
+    std::cerr << "Failed to initialize the pipeline components. Are the "
+                 "parameter files loaded?"
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::string window_local_mapping_type;
+  int mapper_threads;
+  double translation_threshold_kf, rotation_threshold_kf;
+  if (!pu::Get("window_local_mapping_type", window_local_mapping_type) ||
+      !pu::Get("mapper/num_threads", mapper_threads) ||
+      !pu::Get("translation_threshold_kf", translation_threshold_kf) ||
+      !pu::Get("rotation_threshold_kf", rotation_threshold_kf)) {
+    std::cerr << "Failed to load mapper/keyframe parameters." << std::endl;
+    return EXIT_FAILURE;
+  }
+  IPointCloudMapper::Ptr mapper;
+  if (window_local_mapping_type == "voxel_hash_mapper")
+    mapper = IPointCloudMapper::Ptr(new VoxelHashMapper());
+  else
+    mapper = mapperFabric(window_local_mapping_type);
+  mapper->SetupNumberThreads(mapper_threads);
+  if (!mapper->Initialize(n)) {
+    std::cerr << "Failed to initialize the mapper." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  StageProfiler profiler;
+  PointCloudF::Ptr msg_transformed(new PointCloudF());
+  PointCloudF::Ptr msg_neighbors(new PointCloudF());
+  PointCloudF::Ptr msg_base(new PointCloudF());
+  PointCloudF::Ptr msg_fixed(new PointCloudF());
+  PointCloudF::Ptr mapper_unused(new PointCloudF());
+
+  std::vector<gu::Transform3> trajectory;
+  trajectory.reserve(scan_files.size());
+
+  bool b_first_scan = true;
+  gu::Transform3 last_keyframe_pose;
+
+  // Produces the next scan from whichever source was given. PCD loads go
+  // through the PCL reader; log records are unpacked straight from the
+  // mapped file
+  size_t scan_index = 0;
+  std::string scan_label;
+  auto next_scan = [&](PointCloudF::Ptr& scan) -> bool {
+    if (b_replay_log) {
+      const scan_log::RecordHeader* record;
+      const scan_log::LoggedPoint* points;
+      if (!log_reader.Next(&record, &points))
+        return false;
+      scan_label = "record " + std::to_string(scan_index++);
+      scan->clear();
+      scan->reserve(record->point_count);
+      for (uint32_t i = 0; i < record->point_count; i++) {
+        PointF p;
+        p.x = points[i].x;
+        p.y = points[i].y;
+        p.z = points[i].z;
+        p.intensity = points[i].intensity;
+        p.normal_x = points[i].normal_x;
+        p.normal_y = points[i].normal_y;
+        p.normal_z = points[i].normal_z;
+        p.curvature = points[i].curvature;
+        scan->push_back(p);
+      }
+      return true;
+    }
+    while (scan_index < scan_files.size()) {
+      scan_label = scan_files[scan_index++];
+      if (pcl::io::loadPCDFile<PointF>(scan_label, *scan) >= 0)
+        return true;
+      std::cerr << "Failed to load " << scan_label << ", skipping."
+                << std::endl;
+    }
+    return false;
+  };
+
+  const auto replay_start = std::chrono::steady_clock::now();
+
+  PointCloudF::Ptr scan(new PointCloudF());
+  while (next_scan(scan)) {
+    PointCloudF::Ptr msg_filtered(new PointCloudF());
+    if (b_replay_log) {
+      // The log holds the already-filtered scans, so the filter stage is
+      // skipped on replay
+      *msg_filtered = *scan;
+    } else {
+      ScopedStageTimer timer(&profiler, StageProfiler::FILTER);
+      filter.Filter(scan, msg_filtered, false);
+    }
+
+    odometry.SetLidar(msg_filtered);
+    {
+      ScopedStageTimer timer(&profiler, StageProfiler::SCAN_TO_SCAN_ICP);
+      odometry.UpdateEstimate();
+    }
+
+    if (b_first_scan) {
+      localization.TransformPointsToFixedFrame(*scan, msg_transformed.get());
+      mapper->UpdateCurrentPose(localization.GetIntegratedEstimate());
+      mapper->InsertPoints(msg_transformed, mapper_unused.get());
+      localization.SignalMapUpdate();
+      b_first_scan = false;
+      last_keyframe_pose = localization.GetIntegratedEstimate();
+      trajectory.push_back(last_keyframe_pose);
+      continue;
+    }
+
+    localization.MotionUpdate(odometry.GetIncrementalEstimate());
+    localization.TransformPointsToFixedFrame(*msg_filtered,
+                                             msg_transformed.get());
+    {
+      ScopedStageTimer timer(&profiler, StageProfiler::NN_EXTRACTION);
+      if (!mapper->ApproxNearestNeighbors(*msg_transformed,
+                                          msg_neighbors.get())) {
+        std::cerr << "ApproxNearestNeighbors failed for " << scan_label
+                  << std::endl;
+        continue;
+      }
+    }
+
+    localization.TransformPointsToSensorFrame(*msg_neighbors,
+                                              msg_neighbors.get());
+    {
+      ScopedStageTimer timer(&profiler, StageProfiler::SCAN_TO_MAP_ICP);
+      localization.MeasurementUpdate(
+          msg_filtered, msg_neighbors, msg_base.get());
+    }
+
+    const gu::Transform3 current_pose = localization.GetIntegratedEstimate();
+    trajectory.push_back(current_pose);
+
+    // Same keyframe policy as the live pipeline
+    const auto delta = gu::PoseDelta(last_keyframe_pose, current_pose);
+    Eigen::Quaterniond q(delta.rotation.Eigen());
+    if (delta.translation.Norm() > translation_threshold_kf ||
+        fabs(2 * acos(q.w())) > rotation_threshold_kf) {
+      ScopedStageTimer timer(&profiler, StageProfiler::MAP_INSERT);
+      localization.MotionUpdate(gu::Transform3::Identity());
+      localization.TransformPointsToFixedFrame(*scan, msg_fixed.get());
+      mapper->UpdateCurrentPose(current_pose);
+      mapper->InsertPoints(msg_fixed, mapper_unused.get());
+      localization.SignalMapUpdate();
+      last_keyframe_pose = current_pose;
+    }
+  }
+
+  const std::chrono::duration<double> replay_duration =
+      std::chrono::steady_clock::now() - replay_start;
+
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+
+  std::cout << "locus_bench: " << trajectory.size() << " scans in "
+            << replay_duration.count() << " s ("
+            << trajectory.size() / replay_duration.count() << " scans/s)"
+            << std::endl;
+  std::cout << "  peak RSS: " << usage.ru_maxrss / 1024 << " MB" << std::endl;
+  for (size_t stage = 0; stage < StageProfiler::NUM_STAGES; stage++)
+    PrintStageSummary(profiler, stage);
+
+  if (argc > 2) {
+    std::ofstream trajectory_file(argv[2]);
+    trajectory_file << "index,x,y,z,roll,pitch,yaw" << std::endl;
+    for (size_t i = 0; i < trajectory.size(); i++) {
+      const Eigen::Vector3d t = trajectory[i].translation.Eigen();
+      trajectory_file << i << "," << t.x() << "," << t.y() << "," << t.z()
+                      << "," << trajectory[i].rotation.Roll() << ","
+                      << trajectory[i].rotation.Pitch() << ","
+                      << trajectory[i].rotation.Yaw() << std::endl;
+    }
+    std::cout << "  trajectory written to " << argv[2] << std::endl;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -6,6 +6,7 @@ Authors:
 
 #include <gtest/gtest.h>
 #include <locus/Locus.h>
+#include <locus/VoxelHashMapper.h>
 
 class LocusTest : public ::testing::Test {
 public:
@@ -59,6 +60,122 @@ protected:
 private:
 };
 
+/* TEST StampedRingBuffer nearest-in-time lookup */
+TEST(StampedRingBufferTest, TestGetClosest) {
+  StampedRingBuffer<sensor_msgs::Imu> buffer;
+  buffer.SetCapacity(10);
+  sensor_msgs::Imu imu_msg;
+  for (int i = 0; i < 5; i++) {
+    imu_msg.header.stamp = ros::Time(10.0 + 0.1 * i);
+    imu_msg.header.seq = i;
+    buffer.Insert(imu_msg);
+  }
+  sensor_msgs::Imu result;
+  double time_diff;
+  ASSERT_TRUE(buffer.GetClosest(10.24, &result, &time_diff));
+  EXPECT_EQ(result.header.seq, 2u);
+  EXPECT_NEAR(time_diff, -0.04, 1e-6);
+}
+
+/* TEST StampedRingBuffer overwrites the oldest entry when full */
+TEST(StampedRingBufferTest, TestOverwriteOldest) {
+  StampedRingBuffer<sensor_msgs::Imu> buffer;
+  buffer.SetCapacity(3);
+  sensor_msgs::Imu imu_msg;
+  for (int i = 0; i < 5; i++) {
+    imu_msg.header.stamp = ros::Time(10.0 + 0.1 * i);
+    imu_msg.header.seq = i;
+    buffer.Insert(imu_msg);
+  }
+  EXPECT_EQ(buffer.Size(), 3u);
+  // The two oldest entries are gone so the closest to t=10.0 is now t=10.2
+  sensor_msgs::Imu result;
+  double time_diff;
+  ASSERT_TRUE(buffer.GetClosest(10.0, &result, &time_diff));
+  EXPECT_EQ(result.header.seq, 2u);
+}
+
+/* TEST CloudBufferPool recycles released storage at stable capacity */
+TEST_F(LocusTest, TestCloudBufferPoolRecycles) {
+  CloudBufferPool pool;
+
+  PointCloudF::Ptr cloud = pool.Acquire();
+  cloud->resize(1000);
+  const size_t capacity = cloud->points.capacity();
+  PointF* storage = cloud->points.data();
+  cloud.reset();
+
+  // The recycled buffer comes back empty but keeps its allocation
+  PointCloudF::Ptr recycled = pool.Acquire();
+  EXPECT_TRUE(recycled->empty());
+  EXPECT_EQ(recycled->points.capacity(), capacity);
+  EXPECT_EQ(recycled->points.data(), storage);
+
+  // A second handle taken while the first is live gets distinct storage
+  PointCloudF::Ptr other = pool.Acquire();
+  EXPECT_NE(other->points.data(), recycled->points.data());
+}
+
+/* TEST StageProfiler aggregates percentiles and drains on snapshot */
+TEST_F(LocusTest, TestStageProfilerSnapshot) {
+  StageProfiler profiler;
+  for (int i = 0; i < 95; i++)
+    profiler.Record(StageProfiler::FILTER, 0.010);
+  for (int i = 0; i < 5; i++)
+    profiler.Record(StageProfiler::FILTER, 1.0);
+
+  StageProfiler::Summary summary = profiler.Snapshot(StageProfiler::FILTER);
+  EXPECT_EQ(summary.count, 100u);
+  // Percentiles are the upper edge of the containing bin, so they sit just
+  // above the recorded duration
+  EXPECT_GT(summary.p50, 0.010);
+  EXPECT_LT(summary.p50, 0.020);
+  EXPECT_LT(summary.p95, 0.020);
+  EXPECT_GT(summary.p99, 0.5);
+
+  // Snapshot drains the window
+  EXPECT_EQ(profiler.Snapshot(StageProfiler::FILTER).count, 0u);
+}
+
+/* TEST VoxelHashMapper stores, queries and slides without a refresh */
+TEST_F(LocusTest, TestVoxelHashMapperSlidingWindow) {
+  ros::NodeHandle nh;
+  VoxelHashMapper mapper;
+  mapper.SetBoxFilterSize(20);
+  mapper.SetupNumberThreads(1);
+  ASSERT_TRUE(mapper.Initialize(nh));
+
+  geometry_utils::Transform3 origin;
+  mapper.UpdateCurrentPose(origin);
+
+  PointCloudF::Ptr points(new PointCloudF());
+  PointF p;
+  p.x = 1.0;
+  p.y = 2.0;
+  p.z = 0.0;
+  points->push_back(p);
+  PointCloudF incremental;
+  ASSERT_TRUE(mapper.InsertPoints(points, &incremental));
+  EXPECT_EQ(incremental.size(), 1u);
+
+  // A nearby query finds the stored point through the hash
+  PointCloudF query, neighbors;
+  p.x = 1.1;
+  query.push_back(p);
+  ASSERT_TRUE(mapper.ApproxNearestNeighbors(query, &neighbors));
+  ASSERT_EQ(neighbors.size(), 1u);
+  EXPECT_NEAR(neighbors.points[0].x, 1.0, 1e-6);
+
+  // Slide the window far away: the old point leaves the window and the
+  // query comes back empty, with no refresh call in between
+  geometry_utils::Transform3 far_pose;
+  far_pose.translation = geometry_utils::Vec3(100.0, 0.0, 0.0);
+  mapper.Refresh(far_pose);
+  neighbors.clear();
+  EXPECT_FALSE(mapper.ApproxNearestNeighbors(query, &neighbors));
+  EXPECT_EQ(neighbors.size(), 0u);
+}
+
 /* TEST Initialize */
 TEST_F(LocusTest, TestInitialize) {
   ros::NodeHandle nh;
@@ -41,6 +41,7 @@
 #ifndef MULTITHREADED_GICP_H_
 #define MULTITHREADED_GICP_H_
 
+#include <cstdint>
 #include <omp.h>
 
 #include <frontend_utils/CommonFunctions.h>
@@ -107,6 +108,46 @@ public:
 
   typedef Eigen::Matrix<double, 6, 1> Vector6d;
 
+  /** \brief Compact per-point covariance storage: the six unique entries of
+   * each symmetric 3x3 matrix kept as floats in component-major (SoA) order,
+   * 24 bytes per point instead of the 72 of MatricesVector.
+   */
+  struct CompactCovarianceSoA
+  {
+    /** \brief Six planes of num_points floats: xx, xy, xz, yy, yz, zz. */
+    std::vector<float> planes;
+    size_t num_points = 0;
+
+    void pack(const MatricesVector& covariances)
+    {
+      num_points = covariances.size();
+      planes.resize(6 * num_points);
+      for (size_t i = 0; i < num_points; i++)
+      {
+        const Eigen::Matrix3d& C = covariances[i];
+        planes[0 * num_points + i] = static_cast<float>(C(0, 0));
+        planes[1 * num_points + i] = static_cast<float>(C(0, 1));
+        planes[2 * num_points + i] = static_cast<float>(C(0, 2));
+        planes[3 * num_points + i] = static_cast<float>(C(1, 1));
+        planes[4 * num_points + i] = static_cast<float>(C(1, 2));
+        planes[5 * num_points + i] = static_cast<float>(C(2, 2));
+      }
+    }
+
+    inline Eigen::Matrix3d unpack(size_t i) const
+    {
+      const double xx = planes[0 * num_points + i];
+      const double xy = planes[1 * num_points + i];
+      const double xz = planes[2 * num_points + i];
+      const double yy = planes[3 * num_points + i];
+      const double yz = planes[4 * num_points + i];
+      const double zz = planes[5 * num_points + i];
+      Eigen::Matrix3d C;
+      C << xx, xy, xz, xy, yy, yz, xz, yz, zz;
+      return C;
+    }
+  };
+
   /** \brief Empty constructor. */
   MultithreadedGeneralizedIterativeClosestPoint()
     : k_correspondences_(20)
@@ -114,11 +155,17 @@ public:
     , reclculate_cov_normal_point_clouds_(false)
     , recompute_target_cov_(false)
     , recompute_source_cov(false)
+    , b_compact_covariance_storage_(false)
     , k_num_threads_(1)
     , gicp_epsilon_(0.001)
     , rotation_epsilon_(2e-3)
     , mahalanobis_(0)
     , max_inner_iterations_(20)
+    , cached_source_stamp_(0)
+    , cached_source_size_(0)
+    , last_covariance_time_(0.0)
+    , last_correspondence_time_(0.0)
+    , last_optimization_time_(0.0)
   {
     min_number_correspondences_ = 4;
     reg_name_ = "MultithreadedGeneralizedIterativeClosestPoint";
@@ -143,6 +190,28 @@ public:
     k_enable_timing_output_ = enable;
   }
 
+  /** \brief Wall time of the covariance phase of the last align () call, in
+    * seconds. Recorded regardless of the timing log flag so benchmarks can
+    * break down where the time went. */
+  inline double getLastCovarianceTime() const
+  {
+    return (last_covariance_time_);
+  }
+
+  /** \brief Accumulated correspondence-search time across the iterations of
+    * the last align () call, in seconds. */
+  inline double getLastCorrespondenceTime() const
+  {
+    return (last_correspondence_time_);
+  }
+
+  /** \brief Accumulated BFGS optimization time across the iterations of the
+    * last align () call, in seconds. */
+  inline double getLastOptimizationTime() const
+  {
+    return (last_optimization_time_);
+  }
+
   // template <typename PointSource, typename PointTarget>
   // static GeneralizedIterativeClosestPoint<PointSource, PointTarget>
   // MultithreadedGeneralizedIterativeClosestPoint ()
@@ -189,6 +258,16 @@ public:
     input_covariances_ = covariances;
   }
 
+  /** \brief \return the covariances of the current input source, available
+   * once align() has computed them (or after setSourceCovariances()). Lets
+   * another instance registering the same cloud consume them directly
+   * instead of converting the normals to covariances again
+   */
+  inline MatricesVectorPtr getSourceCovariances() const
+  {
+    return input_covariances_;
+  }
+
   /** \brief Provide a pointer to the input target (e.g., the point cloud that
    * we want to align the input source to) \param[in] target the input point
    * cloud target
@@ -230,6 +309,17 @@ public:
     return mahalanobis_[index];
   }
 
+  /** \brief \return correspondences found in the final alignment iteration,
+   * one entry per source point: the index of the matched target point, or -1
+   * if no target point was within the correspondence distance threshold.
+   * Empty until align() has run. Lets callers reuse the correspondences
+   * instead of searching the target tree again
+   */
+  inline const std::vector<int>& getFinalCorrespondences() const
+  {
+    return final_correspondences_;
+  }
+
   /** \brief Computes rotation matrix derivative.
    * rotation matrix is obtainded from rotation angles x[3], x[4] and x[5]
    * \return d/d_rx, d/d_ry and d/d_rz respectively in g[3], g[4] and g[5]
@@ -297,6 +387,16 @@ public:
     recompute_source_cov = recalculate;
   }
 
+  /** \brief Stream both covariance sets through the compact float SoA layout
+   * during the alignment iterations, halving the memory the
+   * correspondence/Mahalanobis loop reads per point. Disabled by default,
+   * which keeps the double precision MatricesVector path.
+   */
+  void setCompactCovarianceStorage(bool enable)
+  {
+    b_compact_covariance_storage_ = enable;
+  }
+
 protected:
   /** \brief The number of neighbors used for covariances computation.
    * default: 20
@@ -335,9 +435,26 @@ protected:
   /** \brief Target cloud points covariances. */
   MatricesVectorPtr target_covariances_;
 
+  /** \brief Covariances computed for the last input source, kept so they can
+   * be reused when the same cloud returns as the target one frame later
+   * (scan-to-scan odometry). The cloud is identified by its header stamp and
+   * size. */
+  MatricesVectorPtr cached_source_covariances_;
+  std::uint64_t cached_source_stamp_;
+  std::size_t cached_source_size_;
+
   /** \brief Mahalanobis matrices holder. */
   std::vector<Eigen::Matrix3d> mahalanobis_;
 
+  /** \brief Per-source-point target indices of the final alignment iteration,
+   * -1 where no correspondence passed the distance threshold. */
+  std::vector<int> final_correspondences_;
+
+  /** \brief Compact covariance storage used by the alignment iterations when
+   * enabled via setCompactCovarianceStorage(). */
+  CompactCovarianceSoA input_cov_compact_;
+  CompactCovarianceSoA target_cov_compact_;
+
   /** \brief maximum number of optimizations */
   int max_inner_iterations_;
 
@@ -423,6 +540,15 @@ private:
 
   bool recompute_target_cov_;
   bool recompute_source_cov;
+
+  /** \brief Whether the alignment iterations read covariances from the
+   * compact float SoA storage instead of the MatricesVectors. */
+  bool b_compact_covariance_storage_;
+
+  /** \brief Per-phase wall times of the last align () call, in seconds. */
+  double last_covariance_time_;
+  double last_correspondence_time_;
+  double last_optimization_time_;
 };
 }  // namespace pcl
 
@@ -420,9 +420,17 @@ pcl::MultithreadedGeneralizedIterativeClosestPoint<PointSource, PointTarget>::
   // Compute target cloud covariance matrices
   auto start_covariances = std::chrono::steady_clock::now();
   if ((!target_covariances_) || (target_covariances_->empty())) {
-    target_covariances_.reset(new MatricesVector);
-    computeCovariances<PointTarget>(
-        target_, tree_, *target_covariances_, recompute_target_cov_);
+    if (cached_source_covariances_ && !recompute_target_cov_ &&
+        target_->header.stamp == cached_source_stamp_ &&
+        target_->size() == cached_source_size_) {
+      // The previous source came back as the target (scan-to-scan
+      // odometry), so its covariances are still valid
+      target_covariances_ = cached_source_covariances_;
+    } else {
+      target_covariances_.reset(new MatricesVector);
+      computeCovariances<PointTarget>(
+          target_, tree_, *target_covariances_, recompute_target_cov_);
+    }
   }
   // Compute input cloud covariance matrices
   if ((!input_covariances_) || (input_covariances_->empty())) {
@@ -430,7 +438,28 @@ pcl::MultithreadedGeneralizedIterativeClosestPoint<PointSource, PointTarget>::
     computeCovariances<PointSource>(
         input_, tree_reciprocal_, *input_covariances_, recompute_source_cov);
   }
+  // Remember the source covariances: in the scan-to-scan configuration the
+  // same cloud is handed back as the target on the next frame
+  if (!recompute_source_cov && input_covariances_) {
+    cached_source_covariances_ = input_covariances_;
+    cached_source_stamp_ = input_->header.stamp;
+    cached_source_size_ = input_->size();
+  }
+  // Pack both covariance sets into the float SoA layout so the alignment
+  // iterations stream 24 bytes per point instead of 72
+  if (b_compact_covariance_storage_) {
+    input_cov_compact_.pack(*input_covariances_);
+    target_cov_compact_.pack(*target_covariances_);
+  }
   auto end_covariances = std::chrono::steady_clock::now();
+  last_covariance_time_ =
+      static_cast<double>(
+          std::chrono::duration_cast<std::chrono::microseconds>(
+              end_covariances - start_covariances)
+              .count()) *
+      1.0e-6;
+  last_correspondence_time_ = 0.0;
+  last_optimization_time_ = 0.0;
 
   base_transformation_ = Eigen::Matrix4f::Identity();
   nr_iterations_ = 0;
@@ -481,14 +510,23 @@ pcl::MultithreadedGeneralizedIterativeClosestPoint<PointSource, PointTarget>::
       // Check if the distance to the nearest neighbor is smaller than the user
       // imposed threshold
       if (nn_dists[0] < dist_threshold) {
-        Eigen::Matrix3d& C1 = (*input_covariances_)[i];
-        Eigen::Matrix3d& C2 = (*target_covariances_)[nn_indices[0]];
         Eigen::Matrix3d& M = mahalanobis_[i];
-        // M = R*C1
-        M = R * C1;
-        // temp = M*R' + C2 = R*C1*R' + C2
-        Eigen::Matrix3d temp = M * R.transpose();
-        temp += C2;
+        Eigen::Matrix3d temp;
+        if (b_compact_covariance_storage_) {
+          // M = R*C1
+          M = R * input_cov_compact_.unpack(i);
+          // temp = M*R' + C2 = R*C1*R' + C2
+          temp = M * R.transpose();
+          temp += target_cov_compact_.unpack(nn_indices[0]);
+        } else {
+          Eigen::Matrix3d& C1 = (*input_covariances_)[i];
+          Eigen::Matrix3d& C2 = (*target_covariances_)[nn_indices[0]];
+          // M = R*C1
+          M = R * C1;
+          // temp = M*R' + C2 = R*C1*R' + C2
+          temp = M * R.transpose();
+          temp += C2;
+        }
         // M = temp^-1
         M = temp.inverse();
 
@@ -505,6 +543,11 @@ pcl::MultithreadedGeneralizedIterativeClosestPoint<PointSource, PointTarget>::
       return;
     }
 
+    // Keep the full-length (sentinel-bearing) correspondences of this
+    // iteration; once the loop converges the member holds those of the final
+    // iteration for getFinalCorrespondences()
+    final_correspondences_ = target_indices;
+
     // Resize to the actual number of valid correspondences
     source_indices.erase(
         std::remove(source_indices.begin(), source_indices.end(), -1),
@@ -560,6 +603,8 @@ pcl::MultithreadedGeneralizedIterativeClosestPoint<PointSource, PointTarget>::
         1.0e-6;
     // ROS_INFO_STREAM("Lookups: " << lookups_time << " Optimization: " <<
     // optimization_time);
+    last_correspondence_time_ += lookups_time;
+    last_optimization_time_ += optimization_time;
 
     nr_iterations_++;
     // Check for convergence
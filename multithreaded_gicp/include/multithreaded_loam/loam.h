@@ -0,0 +1,186 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Point Cloud Library (PCL) - www.pointclouds.org
+ *  Copyright (c) 2010, Willow Garage, Inc.
+ *  Copyright (c) 2012-, Open Perception, Inc.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ *
+ */
+
+#ifndef MULTITHREADED_LOAM_H_
+#define MULTITHREADED_LOAM_H_
+
+#include <omp.h>
+
+#include <pcl/kdtree/kdtree_flann.h>
+#include <pcl/registration/registration.h>
+#include <ros/ros.h>
+
+namespace pcl
+{
+/** \brief LoamFeatureRegistration aligns the labeled feature clouds produced
+ * by the LOAM-style extraction in PointCloudFilter, as described by Zhang and
+ * Singh in "LOAM: Lidar Odometry and Mapping in Real-time". Corner (edge)
+ * features contribute point-to-line residuals and surface features
+ * point-to-plane residuals, solved with Gauss-Newton over the far smaller
+ * feature sets instead of the full clouds. The feature label is carried in
+ * the curvature field of each point (see PointLabel in PointCloudFilter):
+ * values above edge_label_threshold are treated as edges, the rest as
+ * surfaces. \ingroup registration
+ */
+template <typename PointSource, typename PointTarget>
+class LoamFeatureRegistration : public Registration<PointSource, PointTarget>
+{
+public:
+  using Registration<PointSource, PointTarget>::reg_name_;
+  using Registration<PointSource, PointTarget>::getClassName;
+  using Registration<PointSource, PointTarget>::input_;
+  using Registration<PointSource, PointTarget>::target_;
+  using Registration<PointSource, PointTarget>::nr_iterations_;
+  using Registration<PointSource, PointTarget>::max_iterations_;
+  using Registration<PointSource, PointTarget>::final_transformation_;
+  using Registration<PointSource, PointTarget>::transformation_;
+  using Registration<PointSource, PointTarget>::transformation_epsilon_;
+  using Registration<PointSource, PointTarget>::converged_;
+  using Registration<PointSource, PointTarget>::corr_dist_threshold_;
+  using Registration<PointSource, PointTarget>::min_number_correspondences_;
+
+  typedef pcl::PointCloud<PointSource> PointCloudSource;
+  typedef typename PointCloudSource::Ptr PointCloudSourcePtr;
+  typedef typename PointCloudSource::ConstPtr PointCloudSourceConstPtr;
+
+  typedef pcl::PointCloud<PointTarget> PointCloudTarget;
+  typedef typename PointCloudTarget::Ptr PointCloudTargetPtr;
+  typedef typename PointCloudTarget::ConstPtr PointCloudTargetConstPtr;
+
+  typedef boost::shared_ptr<LoamFeatureRegistration<PointSource, PointTarget>> Ptr;
+  typedef boost::shared_ptr<const LoamFeatureRegistration<PointSource, PointTarget>> ConstPtr;
+
+  typedef Eigen::Matrix<double, 6, 1> Vector6d;
+  typedef Eigen::Matrix<double, 6, 6> Matrix6d;
+
+  LoamFeatureRegistration()
+    : num_threads_(omp_get_max_threads())
+    , edge_label_threshold_(0.5f)
+    , edge_neighbors_(5)
+    , plane_neighbors_(5)
+    , b_enable_timing_output_(false)
+  {
+    reg_name_ = "LoamFeatureRegistration";
+  }
+
+  virtual ~LoamFeatureRegistration() {}
+
+  /** \brief Provide a pointer to the labeled target feature cloud; splits it
+   * into edge and surface sets and builds their search trees.
+   * \param[in] cloud the target feature cloud
+   */
+  inline void
+  setInputTarget(const PointCloudTargetConstPtr& cloud)
+  {
+    Registration<PointSource, PointTarget>::setInputTarget(cloud);
+    splitTarget();
+  }
+
+  /** \brief Set the number of threads the correspondence search runs on.
+   * \param[in] num_threads number of OpenMP threads
+   */
+  inline void
+  setNumThreads(int num_threads)
+  {
+    num_threads_ = num_threads;
+  }
+
+  /** \brief Print the duration of each alignment when enabled.
+   * \param[in] b_enable_timing_output timing output flag
+   */
+  inline void
+  enableTimingOutput(bool b_enable_timing_output)
+  {
+    b_enable_timing_output_ = b_enable_timing_output;
+  }
+
+  /** \brief Set the curvature-field label above which a point counts as an
+   * edge feature.
+   * \param[in] threshold the label threshold
+   */
+  inline void
+  setEdgeLabelThreshold(float threshold)
+  {
+    edge_label_threshold_ = threshold;
+  }
+
+protected:
+  virtual void
+  computeTransformation(PointCloudSource& output, const Eigen::Matrix4f& guess);
+
+  /** \brief Split target_ into the edge and surface feature sets and build
+   * one kd-tree per set.
+   */
+  void
+  splitTarget();
+
+  /** \brief Accumulate the Gauss-Newton normal equations of the edge
+   * (point-to-line) and surface (point-to-plane) residuals at the given pose.
+   * \param[in] transform current source-to-target estimate
+   * \param[out] JTJ accumulated approximate Hessian
+   * \param[out] JTr accumulated gradient
+   * \return the number of valid correspondences
+   */
+  int
+  buildNormalEquations(const Eigen::Isometry3d& transform, Matrix6d& JTJ, Vector6d& JTr);
+
+  /** \brief Number of OpenMP threads used by the correspondence search. */
+  int num_threads_;
+
+  /** \brief Curvature-field label above which a point is an edge feature. */
+  float edge_label_threshold_;
+
+  /** \brief Neighbors used for the line and plane fits. */
+  int edge_neighbors_;
+  int plane_neighbors_;
+
+  bool b_enable_timing_output_;
+
+  /** \brief Target feature sets and their search trees. */
+  PointCloudTargetPtr target_edges_;
+  PointCloudTargetPtr target_planes_;
+  pcl::KdTreeFLANN<PointTarget> edge_tree_;
+  pcl::KdTreeFLANN<PointTarget> plane_tree_;
+};
+}  // namespace pcl
+
+#include <multithreaded_loam/loam.hpp>
+
+#endif  //#ifndef MULTITHREADED_LOAM_H_
@@ -0,0 +1,278 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Point Cloud Library (PCL) - www.pointclouds.org
+ *  Copyright (c) 2010, Willow Garage, Inc.
+ *  Copyright (c) 2012-, Open Perception, Inc.
+ *
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder(s) nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ *
+ */
+
+#ifndef MULTITHREADED_LOAM_HPP_
+#define MULTITHREADED_LOAM_HPP_
+
+#include <chrono>
+
+#include <pcl/common/transforms.h>
+
+////////////////////////////////////////////////////////////////////////////////
+template <typename PointSource, typename PointTarget>
+void pcl::LoamFeatureRegistration<PointSource, PointTarget>::splitTarget()
+{
+  target_edges_.reset(new PointCloudTarget);
+  target_planes_.reset(new PointCloudTarget);
+  for (const auto& p : target_->points)
+  {
+    if (p.curvature > edge_label_threshold_)
+      target_edges_->push_back(p);
+    else
+      target_planes_->push_back(p);
+  }
+  if (target_edges_->size() > 0)
+    edge_tree_.setInputCloud(target_edges_);
+  if (target_planes_->size() > 0)
+    plane_tree_.setInputCloud(target_planes_);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+template <typename PointSource, typename PointTarget>
+int pcl::LoamFeatureRegistration<PointSource, PointTarget>::buildNormalEquations(
+    const Eigen::Isometry3d& transform, Matrix6d& JTJ, Vector6d& JTr)
+{
+  JTJ.setZero();
+  JTr.setZero();
+
+  const size_t num_points = input_->size();
+  const double corr_dist_sq = corr_dist_threshold_ * corr_dist_threshold_;
+
+  std::vector<Matrix6d, Eigen::aligned_allocator<Matrix6d>> thread_JTJ(
+      num_threads_, Matrix6d::Zero());
+  std::vector<Vector6d, Eigen::aligned_allocator<Vector6d>> thread_JTr(
+      num_threads_, Vector6d::Zero());
+  std::vector<int> thread_count(num_threads_, 0);
+
+  int enable_omp = (1 < num_threads_);
+#pragma omp parallel num_threads(num_threads_) if (enable_omp)
+  {
+    const int tid = omp_get_thread_num();
+    std::vector<int> k_indices;
+    std::vector<float> k_distances;
+
+#pragma omp for schedule(dynamic, 64)
+    for (size_t i = 0; i < num_points; i++)
+    {
+      const PointSource& raw = input_->points[i];
+      const Eigen::Vector3d p =
+          transform * Eigen::Vector3d(raw.x, raw.y, raw.z);
+      PointTarget query;
+      query.x = p.x();
+      query.y = p.y();
+      query.z = p.z();
+
+      // Residual r with unit direction n: both costs reduce to a scalar
+      // along n, so one Jacobian form [(p x n)^T, n^T] covers them
+      double residual = 0.0;
+      Eigen::Vector3d n = Eigen::Vector3d::Zero();
+      bool valid = false;
+
+      if (raw.curvature > edge_label_threshold_)
+      {
+        // Point-to-line: fit the line through the nearest edge features
+        if (target_edges_->size() <
+            static_cast<size_t>(edge_neighbors_))
+          continue;
+        edge_tree_.nearestKSearch(query, edge_neighbors_, k_indices, k_distances);
+        if (k_distances.back() > corr_dist_sq)
+          continue;
+
+        Eigen::Vector3d centroid = Eigen::Vector3d::Zero();
+        for (int k : k_indices)
+          centroid += target_edges_->points[k].getVector3fMap().template cast<double>();
+        centroid /= k_indices.size();
+
+        Eigen::Matrix3d covariance = Eigen::Matrix3d::Zero();
+        for (int k : k_indices)
+        {
+          const Eigen::Vector3d d =
+              target_edges_->points[k].getVector3fMap().template cast<double>() - centroid;
+          covariance += d * d.transpose();
+        }
+        Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> solver(covariance);
+
+        // Only well-conditioned lines: the largest eigenvalue has to
+        // dominate the mid one
+        if (solver.eigenvalues()(2) > 3.0 * solver.eigenvalues()(1))
+        {
+          const Eigen::Vector3d direction = solver.eigenvectors().col(2);
+          const Eigen::Vector3d offset =
+              (Eigen::Matrix3d::Identity() - direction * direction.transpose()) *
+              (p - centroid);
+          residual = offset.norm();
+          if (residual > 1.0e-9)
+          {
+            n = offset / residual;
+            valid = true;
+          }
+        }
+      }
+      else
+      {
+        // Point-to-plane: fit the plane n . x + 1 = 0 through the nearest
+        // surface features
+        if (target_planes_->size() <
+            static_cast<size_t>(plane_neighbors_))
+          continue;
+        plane_tree_.nearestKSearch(
+            query, plane_neighbors_, k_indices, k_distances);
+        if (k_distances.back() > corr_dist_sq)
+          continue;
+
+        Eigen::MatrixXd A(plane_neighbors_, 3);
+        for (int j = 0; j < plane_neighbors_; j++)
+          A.row(j) = target_planes_->points[k_indices[j]]
+                         .getVector3fMap()
+                         .template cast<double>();
+        const Eigen::Vector3d plane =
+            A.colPivHouseholderQr().solve(
+                -Eigen::VectorXd::Ones(plane_neighbors_));
+        const double norm = plane.norm();
+        if (norm < 1.0e-9)
+          continue;
+
+        // Reject fits where any support point is off the plane
+        bool planar = true;
+        for (int j = 0; j < plane_neighbors_; j++)
+        {
+          if (std::fabs(plane.dot(A.row(j)) + 1.0) / norm > 0.2)
+          {
+            planar = false;
+            break;
+          }
+        }
+        if (planar)
+        {
+          residual = (plane.dot(p) + 1.0) / norm;
+          n = plane / norm;
+          if (residual < 0.0)
+          {
+            residual = -residual;
+            n = -n;
+          }
+          valid = true;
+        }
+      }
+
+      if (!valid)
+        continue;
+
+      // Left perturbation: dp/d(dtheta) = -[p]x, dp/d(dt) = I, projected on n
+      Vector6d J;
+      J.template head<3>() = p.cross(n);
+      J.template tail<3>() = n;
+      thread_JTJ[tid] += J * J.transpose();
+      thread_JTr[tid] += -residual * J;
+      thread_count[tid]++;
+    }
+  }
+
+  int count = 0;
+  for (int t = 0; t < num_threads_; t++)
+  {
+    JTJ += thread_JTJ[t];
+    JTr += thread_JTr[t];
+    count += thread_count[t];
+  }
+  return count;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+template <typename PointSource, typename PointTarget>
+void pcl::LoamFeatureRegistration<PointSource, PointTarget>::computeTransformation(
+    PointCloudSource& output, const Eigen::Matrix4f& guess)
+{
+  const auto start = std::chrono::high_resolution_clock::now();
+
+  converged_ = false;
+  Eigen::Isometry3d transform(guess.cast<double>());
+
+  for (nr_iterations_ = 0; nr_iterations_ < max_iterations_; nr_iterations_++)
+  {
+    Matrix6d JTJ;
+    Vector6d JTr;
+    const int count = buildNormalEquations(transform, JTJ, JTr);
+    if (count < min_number_correspondences_)
+    {
+      ROS_WARN_STREAM(getClassName()
+                      << ": not enough feature correspondences (" << count
+                      << ")");
+      break;
+    }
+
+    const Vector6d delta = JTJ.ldlt().solve(JTr);
+    if (!delta.allFinite())
+      break;
+
+    Eigen::Isometry3d update = Eigen::Isometry3d::Identity();
+    const Eigen::Vector3d rotation = delta.template head<3>();
+    if (rotation.norm() > 1.0e-12)
+      update.linear() =
+          Eigen::AngleAxisd(rotation.norm(), rotation.normalized())
+              .toRotationMatrix();
+    update.translation() = delta.template tail<3>();
+    transform = update * transform;
+
+    if (delta.norm() < transformation_epsilon_)
+    {
+      converged_ = true;
+      break;
+    }
+  }
+
+  final_transformation_ = transform.matrix().cast<float>();
+  transformation_ = final_transformation_;
+  pcl::transformPointCloud(*input_, output, final_transformation_);
+
+  if (b_enable_timing_output_)
+  {
+    const auto end = std::chrono::high_resolution_clock::now();
+    ROS_INFO_STREAM(
+        getClassName() << ": alignment took "
+                       << std::chrono::duration_cast<std::chrono::microseconds>(
+                              end - start)
+                              .count() *
+            1.0e-6
+                       << " s over " << nr_iterations_ << " iterations");
+  }
+}
+
+#endif  //#ifndef MULTITHREADED_LOAM_HPP_
@@ -137,6 +137,28 @@ public:
     return (resolution_);
   }
 
+  /** \brief Set/change the coarse resolution pyramid used for coarse-to-fine
+   * alignment. Each entry builds an additional voxel grid over the target;
+   * alignment runs through them in order, warm-starting the next level, before
+   * finishing at \ref resolution_. \param[in] coarse_resolutions coarse voxel
+   * side lengths, ordered coarsest first; empty disables the pyramid
+   */
+  inline void
+  setResolutionPyramid(const std::vector<float>& coarse_resolutions) {
+    if (pyramid_resolutions_ != coarse_resolutions) {
+      pyramid_resolutions_ = coarse_resolutions;
+      if (target_)
+        init();
+    }
+  }
+
+  /** \brief Get the coarse resolution pyramid.
+   * \return coarse voxel side lengths, ordered coarsest first
+   */
+  inline const std::vector<float>& getResolutionPyramid() const {
+    return (pyramid_resolutions_);
+  }
+
   /** \brief Get the newton line search maximum step length.
    * \return maximum step length
    */
@@ -259,8 +281,26 @@ protected:
     target_cells_.setInputCloud(target_);
     // Initiate voxel structure.
     target_cells_.filter(true);
+
+    // Initiate one additional voxel structure per coarse pyramid level.
+    pyramid_cells_.clear();
+    for (size_t i = 0; i < pyramid_resolutions_.size(); i++) {
+      const float res = pyramid_resolutions_[i];
+      boost::shared_ptr<TargetGrid> cells(new TargetGrid);
+      cells->setLeafSize(res, res, res);
+      cells->setInputCloud(target_);
+      cells->filter(true);
+      pyramid_cells_.push_back(cells);
+    }
   }
 
+  /** \brief Run the Newton optimization at the currently active resolution
+   * level, continuing from \ref final_transformation_. \param[out] output the
+   * resultant input transfomed point cloud dataset \return true if the level
+   * converged normally, false if the optimization had to bail out
+   */
+  bool alignLevel(PointCloudSource& output);
+
   /** \brief Compute derivatives of probability function w.r.t. the
    * transformation vector. \note Equation 6.10, 6.12 and 6.13 [Magnusson 2009].
    * \param[out] score_gradient the gradient vector of the probability function
@@ -470,11 +510,25 @@ protected:
    * and covariances. */
   TargetGrid target_cells_;
 
+  /** \brief The voxel grid used by the current alignment level; points at
+   * \ref target_cells_ or an entry of \ref pyramid_cells_. */
+  TargetGrid* active_cells_;
+
   // double fitness_epsilon_;
 
   /** \brief The side length of voxels. */
   float resolution_;
 
+  /** \brief The side length of voxels at the current alignment level. */
+  float active_resolution_;
+
+  /** \brief Coarse voxel side lengths for coarse-to-fine alignment, ordered
+   * coarsest first; empty disables the pyramid. */
+  std::vector<float> pyramid_resolutions_;
+
+  /** \brief The coarse voxel grids matching \ref pyramid_resolutions_. */
+  std::vector<boost::shared_ptr<TargetGrid>> pyramid_cells_;
+
   /** \brief The maximum step length. */
   double step_size_;
 
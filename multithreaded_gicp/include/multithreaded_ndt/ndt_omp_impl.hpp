@@ -47,7 +47,9 @@ template <typename PointSource, typename PointTarget>
 pclomp::NormalDistributionsTransform<PointSource, PointTarget>::
     NormalDistributionsTransform()
   : target_cells_(),
+    active_cells_(&target_cells_),
     resolution_(1.0f),
+    active_resolution_(1.0f),
     step_size_(0.1),
     outlier_ratio_(0.55),
     gauss_d1_(),
@@ -101,6 +103,33 @@ template <typename PointSource, typename PointTarget>
 void pclomp::NormalDistributionsTransform<PointSource, PointTarget>::
     computeTransformation(PointCloudSource& output,
                           const Eigen::Matrix4f& guess) {
+  if (guess != Eigen::Matrix4f::Identity()) {
+    // Initialise final transformation to the guessed one
+    final_transformation_ = guess;
+    // Apply guessed transformation prior to search for neighbours
+    transformPointCloud(output, output, guess);
+  }
+
+  // Coarse-to-fine: each coarse pyramid level runs the full Newton iteration
+  // against its own voxel grid and leaves its result in final_transformation_
+  // (and output), warm-starting the next level. The configured resolution is
+  // always the final level
+  for (size_t level = 0; level < pyramid_cells_.size(); level++) {
+    active_cells_ = pyramid_cells_[level].get();
+    active_resolution_ = pyramid_resolutions_[level];
+    if (!alignLevel(output))
+      return;
+  }
+
+  active_cells_ = &target_cells_;
+  active_resolution_ = resolution_;
+  alignLevel(output);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+template <typename PointSource, typename PointTarget>
+bool pclomp::NormalDistributionsTransform<PointSource, PointTarget>::
+    alignLevel(PointCloudSource& output) {
   nr_iterations_ = 0;
   converged_ = false;
 
@@ -108,19 +137,12 @@ void pclomp::NormalDistributionsTransform<PointSource, PointTarget>::
 
   // Initializes the guassian fitting parameters (eq. 6.8) [Magnusson 2009]
   gauss_c1 = 10 * (1 - outlier_ratio_);
-  gauss_c2 = outlier_ratio_ / pow(resolution_, 3);
+  gauss_c2 = outlier_ratio_ / pow(active_resolution_, 3);
   gauss_d3_ = -log(gauss_c2);
   gauss_d1_ = -log(gauss_c1 + gauss_c2) - gauss_d3_;
   gauss_d2_ =
       -2 * log((-log(gauss_c1 * exp(-0.5) + gauss_c2) - gauss_d3_) / gauss_d1_);
 
-  if (guess != Eigen::Matrix4f::Identity()) {
-    // Initialise final transformation to the guessed one
-    final_transformation_ = guess;
-    // Apply guessed transformation prior to search for neighbours
-    transformPointCloud(output, output, guess);
-  }
-
   Eigen::Transform<float, 3, Eigen::Affine, Eigen::ColMajor> eig_transformation;
   eig_transformation.matrix() = final_transformation_;
 
@@ -159,7 +181,7 @@ void pclomp::NormalDistributionsTransform<PointSource, PointTarget>::
     if (delta_p_norm == 0 || delta_p_norm != delta_p_norm) {
       trans_probability_ = score / static_cast<double>(input_->points.size());
       converged_ = delta_p_norm == delta_p_norm;
-      return;
+      return false;
     }
 
     delta_p.normalize();
@@ -206,6 +228,8 @@ void pclomp::NormalDistributionsTransform<PointSource, PointTarget>::
   // scan registration are accurate but the normalization constants need to be
   // modified for it to be globally accurate
   trans_probability_ = score / static_cast<double>(input_->points.size());
+
+  return true;
 }
 
 #ifndef _OPENMP
@@ -279,18 +303,18 @@ double pclomp::NormalDistributionsTransform<PointSource, PointTarget>::
     // neighbor checking.
     switch (search_method) {
     case KDTREE:
-      target_cells_.radiusSearch(
-          x_trans_pt, resolution_, neighborhood, distances);
+      active_cells_->radiusSearch(
+          x_trans_pt, active_resolution_, neighborhood, distances);
       break;
     case DIRECT26:
-      target_cells_.getNeighborhoodAtPoint(x_trans_pt, neighborhood);
+      active_cells_->getNeighborhoodAtPoint(x_trans_pt, neighborhood);
       break;
     default:
     case DIRECT7:
-      target_cells_.getNeighborhoodAtPoint7(x_trans_pt, neighborhood);
+      active_cells_->getNeighborhoodAtPoint7(x_trans_pt, neighborhood);
       break;
     case DIRECT1:
-      target_cells_.getNeighborhoodAtPoint1(x_trans_pt, neighborhood);
+      active_cells_->getNeighborhoodAtPoint1(x_trans_pt, neighborhood);
       break;
     }
 
@@ -673,18 +697,18 @@ void pclomp::NormalDistributionsTransform<PointSource, PointTarget>::
     std::vector<float> distances;
     switch (search_method) {
     case KDTREE:
-      target_cells_.radiusSearch(
-          x_trans_pt, resolution_, neighborhood, distances);
+      active_cells_->radiusSearch(
+          x_trans_pt, active_resolution_, neighborhood, distances);
       break;
     case DIRECT26:
-      target_cells_.getNeighborhoodAtPoint(x_trans_pt, neighborhood);
+      active_cells_->getNeighborhoodAtPoint(x_trans_pt, neighborhood);
       break;
     default:
     case DIRECT7:
-      target_cells_.getNeighborhoodAtPoint7(x_trans_pt, neighborhood);
+      active_cells_->getNeighborhoodAtPoint7(x_trans_pt, neighborhood);
       break;
     case DIRECT1:
-      target_cells_.getNeighborhoodAtPoint1(x_trans_pt, neighborhood);
+      active_cells_->getNeighborhoodAtPoint1(x_trans_pt, neighborhood);
       break;
     }
 
@@ -1076,18 +1100,18 @@ pclomp::NormalDistributionsTransform<PointSource, PointTarget>::calculateScore(
     std::vector<float> distances;
     switch (search_method) {
     case KDTREE:
-      target_cells_.radiusSearch(
-          x_trans_pt, resolution_, neighborhood, distances);
+      active_cells_->radiusSearch(
+          x_trans_pt, active_resolution_, neighborhood, distances);
       break;
     case DIRECT26:
-      target_cells_.getNeighborhoodAtPoint(x_trans_pt, neighborhood);
+      active_cells_->getNeighborhoodAtPoint(x_trans_pt, neighborhood);
       break;
     default:
     case DIRECT7:
-      target_cells_.getNeighborhoodAtPoint7(x_trans_pt, neighborhood);
+      active_cells_->getNeighborhoodAtPoint7(x_trans_pt, neighborhood);
       break;
     case DIRECT1:
-      target_cells_.getNeighborhoodAtPoint1(x_trans_pt, neighborhood);
+      active_cells_->getNeighborhoodAtPoint1(x_trans_pt, neighborhood);
       break;
     }
 
@@ -43,6 +43,7 @@
 #include <pcl/filters/voxel_grid.h>
 #include <pcl/kdtree/kdtree_flann.h>
 #include <pcl/point_types.h>
+#include <set>
 #include <unordered_map>
 
 namespace pclomp {
@@ -99,7 +100,10 @@ public:
         cov_(Eigen::Matrix3d::Identity()),
         icov_(Eigen::Matrix3d::Zero()),
         evecs_(Eigen::Matrix3d::Identity()),
-        evals_(Eigen::Vector3d::Zero()) {}
+        evals_(Eigen::Vector3d::Zero()),
+        pt_sum_(Eigen::Vector3d::Zero()),
+        sq_sum_(Eigen::Matrix3d::Zero()),
+        raw_nr_points_(0) {}
 
     /** \brief Get the voxel covariance.
      * \return covariance matrix
@@ -167,6 +171,19 @@ public:
 
     /** \brief Eigen values of voxel covariance matrix */
     Eigen::Vector3d evals_;
+
+    /** \brief Raw point sum, kept so \ref insertPoints can resume the
+     * running-moment accumulation after the leaf has been finalized */
+    Eigen::Vector3d pt_sum_;
+
+    /** \brief Raw sum of x*xT, companion accumulator to \ref pt_sum_ */
+    Eigen::Matrix3d sq_sum_;
+
+    /** \brief True point count backing the raw accumulators
+     * \note Differs from \ref nr_points when a leaf was flagged as
+     * degenerate (nr_points set to -1) during finalization
+     */
+    int raw_nr_points_;
   };
 
   /** \brief Pointer to VoxelGridCovariance leaf structure */
@@ -270,6 +287,33 @@ public:
     }
   }
 
+  /** \brief Insert additional points into an already initialized voxel
+   * structure, accumulating running moments into the affected leaves only.
+   * Finalization (covariance, inverse and eigen decomposition) of the touched
+   * leaves is deferred to \ref updateVoxelCentroids, so several insertions can
+   * be batched at O(new points) each. Leaves are re-keyed in place when a
+   * point falls outside the current index bounds.
+   * \note Only supported when \ref downsample_all_data_ is disabled.
+   * \param[in] cloud the points to insert
+   */
+  void insertPoints(const PointCloud& cloud);
+
+  /** \brief Remove every voxel whose center lies inside the given
+   * axis-aligned box and rebuild the centroid cloud and kdtree, so a sliding
+   * window can evict departed regions without re-filtering the whole target.
+   * \param[in] box_min minimum corner of the box
+   * \param[in] box_max maximum corner of the box
+   * \return number of voxels removed
+   */
+  int removeBox(const Eigen::Vector4f& box_min, const Eigen::Vector4f& box_max);
+
+  /** \brief Re-finalize the leaves touched by \ref insertPoints from their
+   * raw accumulators and rebuild the centroid cloud and kdtree. Cost is
+   * proportional to the number of touched leaves plus the number of occupied
+   * voxels, not the number of points in the structure.
+   */
+  void updateVoxelCentroids();
+
   /** \brief Get the voxel containing point p.
    * \param[in] index the index of the leaf structure node
    * \return const pointer to leaf structure
@@ -494,6 +538,27 @@ protected:
    */
   void applyFilter(PointCloud& output);
 
+  /** \brief Recompute the finalized statistics of a leaf from its raw
+   * accumulators, mirroring the second pass of \ref applyFilter (covariance
+   * normalization, eigenvalue inflation, inverse covariance).
+   * \param[in,out] leaf the leaf to finalize
+   */
+  void finalizeLeaf(Leaf& leaf);
+
+  /** \brief Re-key all leaves after growing the index bounds to the given
+   * values, so incremental insertions outside the original bounding box keep
+   * the leaf indices consistent with \ref getLeaf and the neighborhood
+   * queries.
+   * \param[in] new_min_b new minimum voxel indices
+   * \param[in] new_max_b new maximum voxel indices
+   */
+  void rekeyLeaves(const Eigen::Vector4i& new_min_b,
+                   const Eigen::Vector4i& new_max_b);
+
+  /** \brief Rebuild \ref voxel_centroids_, its leaf indices and the kdtree
+   * from the current leaves. */
+  void rebuildCentroids();
+
   /** \brief Flag to determine if voxel structure is searchable. */
   bool searchable_;
 
@@ -520,6 +585,10 @@ protected:
   /** \brief KdTree generated using \ref voxel_centroids_ (used for searching).
    */
   pcl::KdTreeFLANN<PointT> kdtree_;
+
+  /** \brief Keys of leaves touched by \ref insertPoints and awaiting
+   * finalization by \ref updateVoxelCentroids. */
+  std::set<size_t> updated_leaves_;
 };
 } // namespace pclomp
 
@@ -285,6 +285,12 @@ pclomp::VoxelGridCovariance<PointT>::applyFilter (PointCloud &output)
     // Normalize the centroid
     Leaf& leaf = it->second;
 
+    // Keep the raw accumulators before this pass finalizes the leaf in
+    // place, so insertPoints () can resume the running moments later
+    leaf.pt_sum_ = leaf.mean_;
+    leaf.sq_sum_ = leaf.cov_;
+    leaf.raw_nr_points_ = leaf.nr_points;
+
     // Normalize the centroid
     leaf.centroid /= static_cast<float> (leaf.nr_points);
     // Point sum used for single pass covariance calculation
@@ -369,6 +375,254 @@ pclomp::VoxelGridCovariance<PointT>::applyFilter (PointCloud &output)
   output.width = static_cast<uint32_t> (output.points.size ());
 }
 
+//////////////////////////////////////////////////////////////////////////////////////////
+template<typename PointT> void
+pclomp::VoxelGridCovariance<PointT>::finalizeLeaf (Leaf &leaf)
+{
+  if (leaf.raw_nr_points_ <= 0)
+    return;
+
+  leaf.nr_points = leaf.raw_nr_points_;
+  leaf.mean_ = leaf.pt_sum_ / leaf.nr_points;
+
+  if (leaf.centroid.size () < 4)
+    leaf.centroid.resize (4);
+  leaf.centroid.setZero ();
+  leaf.centroid[0] = static_cast<float> (leaf.mean_[0]);
+  leaf.centroid[1] = static_cast<float> (leaf.mean_[1]);
+  leaf.centroid[2] = static_cast<float> (leaf.mean_[2]);
+
+  if (leaf.nr_points < min_points_per_voxel_)
+    return;
+
+  // Single pass covariance calculation
+  leaf.cov_ = (leaf.sq_sum_ - 2 * (leaf.pt_sum_ * leaf.mean_.transpose ())) / leaf.nr_points + leaf.mean_ * leaf.mean_.transpose ();
+  leaf.cov_ *= (leaf.nr_points - 1.0) / leaf.nr_points;
+
+  // Normalize Eigen Val such that max no more than 100x min.
+  Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> eigensolver;
+  eigensolver.compute (leaf.cov_);
+  Eigen::Matrix3d eigen_val = eigensolver.eigenvalues ().asDiagonal ();
+  leaf.evecs_ = eigensolver.eigenvectors ();
+
+  if (eigen_val (0, 0) < 0 || eigen_val (1, 1) < 0 || eigen_val (2, 2) <= 0)
+  {
+    leaf.nr_points = -1;
+    return;
+  }
+
+  // Avoids matrices near singularities (eq 6.11)[Magnusson 2009]
+  double min_covar_eigvalue = min_covar_eigvalue_mult_ * eigen_val (2, 2);
+  if (eigen_val (0, 0) < min_covar_eigvalue)
+  {
+    eigen_val (0, 0) = min_covar_eigvalue;
+
+    if (eigen_val (1, 1) < min_covar_eigvalue)
+    {
+      eigen_val (1, 1) = min_covar_eigvalue;
+    }
+
+    leaf.cov_ = leaf.evecs_ * eigen_val * leaf.evecs_.inverse ();
+  }
+  leaf.evals_ = eigen_val.diagonal ();
+
+  leaf.icov_ = leaf.cov_.inverse ();
+  if (leaf.icov_.maxCoeff () == std::numeric_limits<float>::infinity ( )
+      || leaf.icov_.minCoeff () == -std::numeric_limits<float>::infinity ( ) )
+  {
+    leaf.nr_points = -1;
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+template<typename PointT> void
+pclomp::VoxelGridCovariance<PointT>::rekeyLeaves (const Eigen::Vector4i& new_min_b, const Eigen::Vector4i& new_max_b)
+{
+  Map old_leaves;
+  old_leaves.swap (leaves_);
+  std::set<size_t> old_updated;
+  old_updated.swap (updated_leaves_);
+
+  const Eigen::Vector4i old_min_b = min_b_;
+  const Eigen::Vector4i old_div_b = div_b_;
+
+  min_b_ = new_min_b;
+  max_b_ = new_max_b;
+  div_b_ = max_b_ - min_b_ + Eigen::Vector4i::Ones ();
+  div_b_[3] = 0;
+  divb_mul_ = Eigen::Vector4i (1, div_b_[0], div_b_[0] * div_b_[1], 0);
+
+  for (auto it = old_leaves.begin (); it != old_leaves.end (); ++it)
+  {
+    // Decode the old key into grid coordinates, then encode with the new
+    // bounds
+    const size_t old_key = it->first;
+    int ijk0 = static_cast<int> (old_key % old_div_b[0]) + old_min_b[0];
+    int ijk1 = static_cast<int> ((old_key / old_div_b[0]) % old_div_b[1]) + old_min_b[1];
+    int ijk2 = static_cast<int> (old_key / (old_div_b[0] * old_div_b[1])) + old_min_b[2];
+
+    size_t new_key = (ijk0 - min_b_[0]) * divb_mul_[0] + (ijk1 - min_b_[1]) * divb_mul_[1] + (ijk2 - min_b_[2]) * divb_mul_[2];
+    leaves_[new_key] = it->second;
+    if (old_updated.count (old_key))
+      updated_leaves_.insert (new_key);
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+template<typename PointT> void
+pclomp::VoxelGridCovariance<PointT>::insertPoints (const PointCloud &cloud)
+{
+  if (downsample_all_data_)
+  {
+    PCL_WARN ("[pcl::%s::insertPoints] Incremental insertion only supports xyz downsampling!\n", getClassName ().c_str ());
+    return;
+  }
+  if (divb_mul_[1] == 0)
+  {
+    PCL_WARN ("[pcl::%s::insertPoints] Voxel structure not initialized, call filter () first!\n", getClassName ().c_str ());
+    return;
+  }
+
+  // Grow the index bounds first if any incoming point falls outside them, so
+  // every point can be keyed consistently afterwards
+  Eigen::Vector4i new_min_b = min_b_;
+  Eigen::Vector4i new_max_b = max_b_;
+  for (size_t cp = 0; cp < cloud.points.size (); ++cp)
+  {
+    if (!cloud.is_dense)
+      if (!pcl_isfinite (cloud.points[cp].x) ||
+          !pcl_isfinite (cloud.points[cp].y) ||
+          !pcl_isfinite (cloud.points[cp].z))
+        continue;
+
+    new_min_b[0] = std::min (new_min_b[0], static_cast<int> (floor (cloud.points[cp].x * inverse_leaf_size_[0])));
+    new_max_b[0] = std::max (new_max_b[0], static_cast<int> (floor (cloud.points[cp].x * inverse_leaf_size_[0])));
+    new_min_b[1] = std::min (new_min_b[1], static_cast<int> (floor (cloud.points[cp].y * inverse_leaf_size_[1])));
+    new_max_b[1] = std::max (new_max_b[1], static_cast<int> (floor (cloud.points[cp].y * inverse_leaf_size_[1])));
+    new_min_b[2] = std::min (new_min_b[2], static_cast<int> (floor (cloud.points[cp].z * inverse_leaf_size_[2])));
+    new_max_b[2] = std::max (new_max_b[2], static_cast<int> (floor (cloud.points[cp].z * inverse_leaf_size_[2])));
+  }
+
+  if (new_min_b != min_b_ || new_max_b != max_b_)
+  {
+    int64_t dx = static_cast<int64_t> (new_max_b[0] - new_min_b[0]) + 1;
+    int64_t dy = static_cast<int64_t> (new_max_b[1] - new_min_b[1]) + 1;
+    int64_t dz = static_cast<int64_t> (new_max_b[2] - new_min_b[2]) + 1;
+    if ((dx * dy * dz) > std::numeric_limits<int32_t>::max ())
+    {
+      PCL_WARN ("[pcl::%s::insertPoints] Leaf size is too small for the grown dataset. Integer indices would overflow.", getClassName ().c_str ());
+      return;
+    }
+    rekeyLeaves (new_min_b, new_max_b);
+  }
+
+  // Accumulate the running moments of the affected leaves; finalization is
+  // deferred to updateVoxelCentroids ()
+  for (size_t cp = 0; cp < cloud.points.size (); ++cp)
+  {
+    if (!cloud.is_dense)
+      if (!pcl_isfinite (cloud.points[cp].x) ||
+          !pcl_isfinite (cloud.points[cp].y) ||
+          !pcl_isfinite (cloud.points[cp].z))
+        continue;
+
+    int ijk0 = static_cast<int> (floor (cloud.points[cp].x * inverse_leaf_size_[0]) - static_cast<float> (min_b_[0]));
+    int ijk1 = static_cast<int> (floor (cloud.points[cp].y * inverse_leaf_size_[1]) - static_cast<float> (min_b_[1]));
+    int ijk2 = static_cast<int> (floor (cloud.points[cp].z * inverse_leaf_size_[2]) - static_cast<float> (min_b_[2]));
+
+    size_t idx = ijk0 * divb_mul_[0] + ijk1 * divb_mul_[1] + ijk2 * divb_mul_[2];
+
+    Leaf& leaf = leaves_[idx];
+    Eigen::Vector3d pt3d (cloud.points[cp].x, cloud.points[cp].y, cloud.points[cp].z);
+    leaf.pt_sum_ += pt3d;
+    leaf.sq_sum_ += pt3d * pt3d.transpose ();
+    ++leaf.raw_nr_points_;
+    updated_leaves_.insert (idx);
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+template<typename PointT> int
+pclomp::VoxelGridCovariance<PointT>::removeBox (const Eigen::Vector4f& box_min, const Eigen::Vector4f& box_max)
+{
+  int removed = 0;
+  for (auto it = leaves_.begin (); it != leaves_.end ();)
+  {
+    // Decode the key into the voxel center
+    const size_t key = it->first;
+    int ijk0 = static_cast<int> (key % div_b_[0]) + min_b_[0];
+    int ijk1 = static_cast<int> ((key / div_b_[0]) % div_b_[1]) + min_b_[1];
+    int ijk2 = static_cast<int> (key / (div_b_[0] * div_b_[1])) + min_b_[2];
+
+    float cx = (static_cast<float> (ijk0) + 0.5f) * leaf_size_[0];
+    float cy = (static_cast<float> (ijk1) + 0.5f) * leaf_size_[1];
+    float cz = (static_cast<float> (ijk2) + 0.5f) * leaf_size_[2];
+
+    if (cx >= box_min[0] && cx <= box_max[0] &&
+        cy >= box_min[1] && cy <= box_max[1] &&
+        cz >= box_min[2] && cz <= box_max[2])
+    {
+      updated_leaves_.erase (key);
+      it = leaves_.erase (it);
+      ++removed;
+    }
+    else
+      ++it;
+  }
+
+  if (removed > 0)
+    rebuildCentroids ();
+
+  return removed;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+template<typename PointT> void
+pclomp::VoxelGridCovariance<PointT>::updateVoxelCentroids ()
+{
+  for (auto key_it = updated_leaves_.begin (); key_it != updated_leaves_.end (); ++key_it)
+  {
+    auto leaf_it = leaves_.find (*key_it);
+    if (leaf_it != leaves_.end ())
+      finalizeLeaf (leaf_it->second);
+  }
+  updated_leaves_.clear ();
+
+  rebuildCentroids ();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+template<typename PointT> void
+pclomp::VoxelGridCovariance<PointT>::rebuildCentroids ()
+{
+  if (!voxel_centroids_)
+    voxel_centroids_ = PointCloudPtr (new PointCloud);
+
+  voxel_centroids_->points.clear ();
+  voxel_centroids_leaf_indices_.clear ();
+  voxel_centroids_->points.reserve (leaves_.size ());
+  voxel_centroids_leaf_indices_.reserve (leaves_.size ());
+
+  for (auto it = leaves_.begin (); it != leaves_.end (); ++it)
+  {
+    const Leaf& leaf = it->second;
+    if (leaf.nr_points >= min_points_per_voxel_)
+    {
+      voxel_centroids_->push_back (PointT ());
+      voxel_centroids_->points.back ().x = leaf.centroid[0];
+      voxel_centroids_->points.back ().y = leaf.centroid[1];
+      voxel_centroids_->points.back ().z = leaf.centroid[2];
+      voxel_centroids_leaf_indices_.push_back (static_cast<int> (it->first));
+    }
+  }
+  voxel_centroids_->width = static_cast<uint32_t> (voxel_centroids_->points.size ());
+  voxel_centroids_->height = 1;
+  voxel_centroids_->is_dense = true;
+
+  if (searchable_ && voxel_centroids_->size () > 0)
+    kdtree_.setInputCloud (voxel_centroids_);
+}
+
 //////////////////////////////////////////////////////////////////////////////////////////
 template<typename PointT> int
 pclomp::VoxelGridCovariance<PointT>::getNeighborhoodAtPoint(const Eigen::MatrixXi& relative_coordinates, const PointT& reference_point, std::vector<LeafConstPtr> &neighbors) const
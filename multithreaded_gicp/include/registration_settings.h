@@ -1,6 +1,6 @@
 #pragma once
 
-enum class RegistrationMethod { GICP, NDT };
+enum class RegistrationMethod { GICP, NDT, NDT_PYRAMID, LOAM };
 
 using EnumToStringRegistrationMethods =
     std::pair<std::string, RegistrationMethod>;
@@ -8,7 +8,10 @@ using EnumToStringRegistrationMethods =
 const std::vector<EnumToStringRegistrationMethods>
     EnumToStringRegistrationMethodsVector = {
         EnumToStringRegistrationMethods("gicp", RegistrationMethod::GICP),
-        EnumToStringRegistrationMethods("ndt", RegistrationMethod::NDT)};
+        EnumToStringRegistrationMethods("ndt", RegistrationMethod::NDT),
+        EnumToStringRegistrationMethods("ndt_pyramid",
+                                        RegistrationMethod::NDT_PYRAMID),
+        EnumToStringRegistrationMethods("loam", RegistrationMethod::LOAM)};
 // TODO: maybe somehow varialbe template, but it's available from cpp17 i think
 RegistrationMethod getRegistrationMethodFromString(const std::string& mode) {
   for (const auto& available_vlo : EnumToStringRegistrationMethodsVector) {
@@ -0,0 +1,223 @@
+#include <frontend_utils/CommonStructs.h>
+#include <multithreaded_gicp/gicp.h>
+#include <multithreaded_ndt/ndt_omp.h>
+#include <omp.h>
+#include <pcl/filters/voxel_grid.h>
+#include <pcl/io/pcd_io.h>
+#include <pcl/point_types.h>
+#include <ros/package.h>
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Thread-scaling benchmark for the multithreaded registration backends.
+// Sweeps setNumThreads(1..max) over the recorded scan pair at several
+// problem sizes (the full clouds plus voxelized reductions standing in for
+// smaller map windows) and reports align time, the GICP per-phase
+// breakdown (covariances / correspondence search / BFGS optimization), and
+// the speedup over the single-threaded run as machine-readable CSV.
+//
+// Usage: bench_thread_scaling [output.csv] [--gate]
+// With --gate the exit code is nonzero when adding a thread made any
+// configuration slower by more than 5%, so CI can gate merges on it.
+
+namespace {
+
+struct BenchResult {
+  std::string method;
+  std::string window;
+  size_t query_points;
+  size_t reference_points;
+  int num_threads;
+  double align_time;
+  double covariance_time;
+  double correspondence_time;
+  double optimization_time;
+};
+
+PointCloudF::Ptr Voxelize(const PointCloudF::Ptr& cloud, float leaf) {
+  if (leaf <= 0.0f)
+    return cloud;
+  PointCloudF::Ptr downsampled(new PointCloudF);
+  pcl::VoxelGrid<PointF> grid;
+  grid.setLeafSize(leaf, leaf, leaf);
+  grid.setInputCloud(cloud);
+  grid.filter(*downsampled);
+  return downsampled;
+}
+
+// Minimum of several repetitions: scheduling noise only ever adds time
+template <typename AlignFn>
+double MinAlignTime(AlignFn align, int repetitions) {
+  double best = -1.0;
+  for (int r = 0; r < repetitions; r++) {
+    const auto start = std::chrono::steady_clock::now();
+    align();
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    if (best < 0.0 || elapsed.count() < best)
+      best = elapsed.count();
+  }
+  return best;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  std::string csv_path;
+  bool gate = false;
+  for (int i = 1; i < argc; i++) {
+    if (std::string(argv[i]) == "--gate")
+      gate = true;
+    else
+      csv_path = argv[i];
+  }
+
+  PointCloudF::Ptr query(new PointCloudF);
+  PointCloudF::Ptr reference(new PointCloudF);
+
+  std::string package_path = ros::package::getPath("multithreaded_gicp");
+
+  if (pcl::io::loadPCDFile<PointF>(package_path + "/test/query_82_garage.pcd",
+                                   *query) == -1) {
+    std::cerr << "Could not load query_82_garage.pcd" << std::endl;
+    return -1;
+  }
+  if (pcl::io::loadPCDFile<PointF>(
+          package_path + "/test/reference_82_garage.pcd", *reference) == -1) {
+    std::cerr << "Could not load reference_82_garage.pcd" << std::endl;
+    return -1;
+  }
+
+  const int max_threads = omp_get_max_threads();
+  const int repetitions = 3;
+
+  // The full pair plus voxelized reductions standing in for smaller map
+  // windows
+  const std::vector<std::pair<std::string, float>> windows = {
+      {"full", 0.0f}, {"medium", 0.25f}, {"small", 0.5f}};
+
+  std::vector<BenchResult> results;
+
+  for (const auto& window : windows) {
+    PointCloudF::Ptr window_query = Voxelize(query, window.second);
+    PointCloudF::Ptr window_reference = Voxelize(reference, window.second);
+
+    for (int n = 1; n <= max_threads; n++) {
+      // GICP
+      {
+        pcl::MultithreadedGeneralizedIterativeClosestPoint<PointF, PointF>
+            icp;
+        icp.setTransformationEpsilon(0.0000000001);
+        icp.setMaxCorrespondenceDistance(0.2);
+        icp.setMaximumIterations(20);
+        icp.setRANSACIterations(0);
+        icp.setMaximumOptimizerIterations(50);
+        icp.setNumThreads(n);
+        icp.setInputSource(window_query);
+        icp.setInputTarget(window_reference);
+
+        BenchResult result;
+        result.method = "gicp";
+        result.window = window.first;
+        result.query_points = window_query->size();
+        result.reference_points = window_reference->size();
+        result.num_threads = n;
+        result.align_time = MinAlignTime(
+            [&icp, &window_query, &window_reference]() {
+              // Re-setting the clouds clears the cached covariances so
+              // every repetition does the full covariance phase
+              icp.setInputSource(window_query);
+              icp.setInputTarget(window_reference);
+              PointCloudF aligned_points;
+              icp.align(aligned_points);
+            },
+            repetitions);
+        result.covariance_time = icp.getLastCovarianceTime();
+        result.correspondence_time = icp.getLastCorrespondenceTime();
+        result.optimization_time = icp.getLastOptimizationTime();
+        results.push_back(result);
+      }
+
+      // NDT (no per-phase breakdown: the Newton iterations interleave the
+      // derivative and line-search work)
+      {
+        pclomp::NormalDistributionsTransform<PointF, PointF> ndt;
+        ndt.setTransformationEpsilon(0.0000000001);
+        ndt.setMaxCorrespondenceDistance(0.2);
+        ndt.setMaximumIterations(20);
+        ndt.setRANSACIterations(0);
+        ndt.setNumThreads(n);
+        ndt.setInputSource(window_query);
+        ndt.setInputTarget(window_reference);
+
+        BenchResult result;
+        result.method = "ndt";
+        result.window = window.first;
+        result.query_points = window_query->size();
+        result.reference_points = window_reference->size();
+        result.num_threads = n;
+        result.align_time = MinAlignTime(
+            [&ndt]() {
+              PointCloudF aligned_points;
+              ndt.align(aligned_points);
+            },
+            repetitions);
+        result.covariance_time = 0.0;
+        result.correspondence_time = 0.0;
+        result.optimization_time = 0.0;
+        results.push_back(result);
+      }
+    }
+  }
+
+  // CSV with speedup over the single-threaded run of the same
+  // method/window
+  std::ostringstream csv;
+  csv << "method,window,query_points,reference_points,num_threads,align_s,"
+         "covariance_s,correspondence_s,optimization_s,speedup_vs_1\n";
+  bool regression = false;
+  for (const auto& result : results) {
+    double single_threaded_time = result.align_time;
+    double previous_time = result.align_time;
+    for (const auto& other : results) {
+      if (other.method == result.method && other.window == result.window) {
+        if (other.num_threads == 1)
+          single_threaded_time = other.align_time;
+        if (other.num_threads == result.num_threads - 1)
+          previous_time = other.align_time;
+      }
+    }
+    csv << result.method << "," << result.window << "," << result.query_points
+        << "," << result.reference_points << "," << result.num_threads << ","
+        << result.align_time << "," << result.covariance_time << ","
+        << result.correspondence_time << "," << result.optimization_time
+        << "," << single_threaded_time / result.align_time << "\n";
+
+    if (result.num_threads > 1 && result.align_time > 1.05 * previous_time) {
+      std::cerr << "REGRESSION: " << result.method << " " << result.window
+                << " with " << result.num_threads << " threads is slower ("
+                << result.align_time << " s) than with "
+                << result.num_threads - 1 << " (" << previous_time << " s)"
+                << std::endl;
+      regression = true;
+    }
+  }
+
+  std::cout << csv.str();
+  if (!csv_path.empty()) {
+    std::ofstream csv_file(csv_path);
+    csv_file << csv.str();
+    std::cout << "Wrote " << csv_path << std::endl;
+  }
+
+  if (gate && regression) {
+    std::cerr << "Thread-scaling gate failed" << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,124 @@
+#ifndef POINT_CLOUD_FILTER_BODY_CROP_BOX_H
+#define POINT_CLOUD_FILTER_BODY_CROP_BOX_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#include <pcl/point_cloud.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace point_cloud_filter {
+
+// Robot body crop shared by the merger and the filter so the self-hit
+// removal the body filter nodelet used to do as its own PointCloud2 pass
+// (deserialize, per-point branch, republish) can instead be fused into a
+// traversal the caller is making anyway. The box matches the nodelet's
+// dynamic reconfigure parameters: an axis-aligned extent rotated about z,
+// with points INSIDE it removed. The inside test rotates and compares the
+// x/y/z/pad block of a point in one vector register when SSE is available,
+// and the in-place Crop compacts survivors with an unconditional write plus
+// masked advance, so neither path branches on the test outcome.
+template <typename PointT>
+class BodyCropBox {
+public:
+  BodyCropBox() : enabled_(false) {
+    Configure(false, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+  }
+
+  // Configure from the body filter nodelet's parameter set: box extent in
+  // meters, rotation of the box about z in radians, and whether the crop is
+  // applied at all
+  void Configure(bool enabled,
+                 float min_x,
+                 float max_x,
+                 float min_y,
+                 float max_y,
+                 float min_z,
+                 float max_z,
+                 float rotation) {
+    enabled_ = enabled;
+    min_[0] = min_x;
+    min_[1] = min_y;
+    min_[2] = min_z;
+    min_[3] = 0.0f;
+    max_[0] = max_x;
+    max_[1] = max_y;
+    max_[2] = max_z;
+    max_[3] = 0.0f;
+    // A point is inside the rotated box iff its coordinates rotated by
+    // -rotation are inside the axis-aligned extent. The two factor vectors
+    // compute that rotation lane-wise against (x, y, z) and (y, x, z):
+    // lane 0 = c*x + s*y, lane 1 = c*y - s*x, lane 2 = z
+    const float c = std::cos(rotation);
+    const float s = std::sin(rotation);
+    cos_factor_[0] = c;
+    cos_factor_[1] = c;
+    cos_factor_[2] = 1.0f;
+    cos_factor_[3] = 0.0f;
+    sin_factor_[0] = s;
+    sin_factor_[1] = -s;
+    sin_factor_[2] = 0.0f;
+    sin_factor_[3] = 0.0f;
+  }
+
+  bool Enabled() const {
+    return enabled_;
+  }
+
+  // True when the point lies inside the (rotated) body box and should be
+  // dropped
+  inline bool Contains(const PointT& point) const {
+#if defined(__SSE2__)
+    // point.data is the 16-byte aligned x/y/z/pad block of the point
+    const __m128 p = _mm_load_ps(point.data);
+    const __m128 swapped = _mm_shuffle_ps(p, p, _MM_SHUFFLE(3, 2, 0, 1));
+    const __m128 rotated =
+        _mm_add_ps(_mm_mul_ps(p, _mm_loadu_ps(cos_factor_)),
+                   _mm_mul_ps(swapped, _mm_loadu_ps(sin_factor_)));
+    const __m128 inside = _mm_and_ps(_mm_cmpge_ps(rotated, _mm_loadu_ps(min_)),
+                                     _mm_cmple_ps(rotated, _mm_loadu_ps(max_)));
+    return (_mm_movemask_ps(inside) & 0x7) == 0x7;
+#else
+    const float rx = cos_factor_[0] * point.x + sin_factor_[0] * point.y;
+    const float ry = cos_factor_[1] * point.y + sin_factor_[1] * point.x;
+    return rx >= min_[0] && rx <= max_[0] && ry >= min_[1] && ry <= max_[1] &&
+        point.z >= min_[2] && point.z <= max_[2];
+#endif
+  }
+
+  // Remove all points inside the box in place and return the number kept.
+  // Survivors are compacted with an unconditional copy and a masked write
+  // cursor advance, so no branch depends on the box test
+  size_t Crop(pcl::PointCloud<PointT>& cloud) const {
+    if (!enabled_) {
+      return cloud.size();
+    }
+    const size_t cloud_size = cloud.size();
+    size_t write = 0;
+    for (size_t i = 0; i < cloud_size; i++) {
+      cloud.points[write] = cloud.points[i];
+      write += static_cast<size_t>(!Contains(cloud.points[write]));
+    }
+    cloud.resize(write);
+    cloud.width = static_cast<uint32_t>(write);
+    cloud.height = 1;
+    return write;
+  }
+
+private:
+  bool enabled_;
+  // Box extent and in-plane rotation factors, laid out as the four float
+  // lanes the vectorized inside test consumes
+  float min_[4];
+  float max_[4];
+  float cos_factor_[4];
+  float sin_factor_[4];
+};
+
+} // namespace point_cloud_filter
+
+#endif
@@ -39,6 +39,8 @@
 
 #include <frontend_utils/CommonStructs.h>
 #include <parameter_utils/ParameterUtils.h>
+#include <point_cloud_filter/BodyCropBox.h>
+#include <point_cloud_filter/VoxelHashGrid.h>
 #include <pcl/filters/filter.h>
 #include <pcl/filters/radius_outlier_removal.h>
 #include <pcl/filters/random_sample.h>
@@ -105,22 +107,64 @@ private:
   std::vector<IndexRange>
       scanIndices_; // < start and end indices of the individual scans withing
                     // the full resolution cloud
-  PointCloudF cornerPointsSharp_;       // < sharp corner points cloud
-  PointCloudF cornerPointsLessSharp_;   // < less sharp corner points cloud
-  PointCloudF surfacePointsFlat_;       // < flat surface points cloud
-  PointCloudF surfacePointsLessFlat_;   // < less flat surface points cloud
-  std::vector<float> regionCurvature_;  // < point curvature buffer
-  std::vector<PointLabel> regionLabel_; // < point label buffer
-  std::vector<size_t>
-      regionSortIndices_; // < sorted region indices based on point curvature
-  std::vector<int>
-      scanNeighborPicked_; // < flag if neighboring point was already picked
+  PointCloudF cornerPointsSharp_;     // < sharp corner points cloud
+  PointCloudF cornerPointsLessSharp_; // < less sharp corner points cloud
+  PointCloudF surfacePointsFlat_;     // < flat surface points cloud
+  PointCloudF surfacePointsLessFlat_; // < less flat surface points cloud
+
+  // Feature clouds of a single scan ring. Each ring is processed
+  // independently (possibly on its own thread) and the per-ring clouds are
+  // merged in ring order afterwards so the output stays deterministic
+  struct RingFeatures {
+    PointCloudF cornerSharp;
+    PointCloudF cornerLessSharp;
+    PointCloudF surfaceFlat;
+    PointCloudF surfaceLessFlat;
+  };
+
+  // Scratch buffers for one feature region, owned by the ring worker
+  struct RegionBuffers {
+    std::vector<float> curvature;       // < point curvature buffer
+    std::vector<PointLabel> label;      // < point label buffer
+    std::vector<size_t> sortIndices;    // < region candidate index buffer
+    std::vector<size_t> cornerCandidates; // < top-k indices by curvature
+    std::vector<size_t> flatCandidates;   // < bottom-k indices by curvature
+  };
+
+  // Fused single-pass decimation + voxelization: decimation is applied as a
+  // uniform stride over the scan while the surviving points are accumulated
+  // directly into voxel centroids, so the input is traversed exactly once and
+  // no intermediate cloud is allocated
+  void FusedDecimateAndVoxelize(const PointCloudF& points,
+                                PointCloudF& points_filtered,
+                                const bool b_is_open_space);
+
+  // Hash-based voxel grid shared with the voxel grid nodelet; persistent so
+  // its table is allocated once
+  point_cloud_filter::VoxelHashGrid<PointF> voxel_hash_grid_;
+
+  // Robot body crop fused into the traversals above, replacing the
+  // standalone body filter nodelet pass in front of the merger
+  point_cloud_filter::BodyCropBox<PointF> body_crop_;
 
   void arrangePCLInScanLines(const PointCloudF& laserCloudIn, float scanPeriod);
   void extractFeatures(const uint16_t& beginIdx = 0);
-  void setRegionBuffersFor(const size_t& startIdx, const size_t& endIdx);
-  void setScanBuffersFor(const size_t& startIdx, const size_t& endIdx);
-  void markAsPicked(const size_t& cloudIdx, const size_t& scanIdx);
+  // Extract the features of a single scan ring into its own clouds; safe to
+  // run concurrently for different rings since all scratch state is local
+  void extractFeaturesFromScan(const size_t scanStartIdx,
+                               const size_t scanEndIdx,
+                               RegionBuffers& region,
+                               std::vector<int>& scanNeighborPicked,
+                               RingFeatures& features);
+  void setRegionBuffersFor(const size_t& startIdx,
+                           const size_t& endIdx,
+                           RegionBuffers& region);
+  void setScanBuffersFor(const size_t& startIdx,
+                         const size_t& endIdx,
+                         std::vector<int>& scanNeighborPicked);
+  void markAsPicked(const size_t& cloudIdx,
+                    const size_t& scanIdx,
+                    std::vector<int>& scanNeighborPicked);
 
   /** \brief Map the specified vertical point angle to its ring ID
    * @param angle the vertical point angle (in rad)
@@ -162,6 +206,10 @@ private:
   struct Parameters {
     // Apply feature extraction
     bool extract_features;
+    // Number of threads the feature extraction spreads the scan rings over
+    int num_threads;
+    // Run decimation and voxelization as one fused pass over the input.
+    bool fused_filter;
     // Apply a voxel grid filter.
     bool grid_filter;
     // Resolution of voxel grid filter.
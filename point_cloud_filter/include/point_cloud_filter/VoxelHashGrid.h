@@ -0,0 +1,239 @@
+#ifndef POINT_CLOUD_FILTER_VOXEL_HASH_GRID_H
+#define POINT_CLOUD_FILTER_VOXEL_HASH_GRID_H
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include <pcl/point_cloud.h>
+
+#include <point_cloud_filter/BodyCropBox.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace point_cloud_filter {
+
+// Centroid voxel grid backed by an open-addressing hash table instead of
+// PCL's sort-based pcl::VoxelGrid. Voxel indices are quantized with SSE when
+// available (the three coordinates of a point are processed in one vector
+// register) and centroids are accumulated into SoA float arrays addressed by
+// linear probing, so no per-scan sort or node allocation takes place. All
+// buffers are persistent and reused across scans. Output point order is
+// unspecified, which no downstream consumer relies on.
+template <typename PointT>
+class VoxelHashGrid {
+public:
+  VoxelHashGrid() : leaf_size_(0.2f) {}
+
+  void SetLeafSize(float leaf_size) {
+    leaf_size_ = leaf_size;
+  }
+
+  float GetLeafSize() const {
+    return leaf_size_;
+  }
+
+  // Replaces output with the voxelized input. A stride > 1 additionally
+  // decimates the input by visiting only every stride-th point, which lets
+  // callers fuse random-downsample-style decimation into the same pass, and
+  // a non-null body crop drops points inside the robot body box before they
+  // are accumulated. Input and output may alias
+  void Downsample(const pcl::PointCloud<PointT>& input,
+                  pcl::PointCloud<PointT>& output,
+                  double stride = 1.0,
+                  const BodyCropBox<PointT>* body_crop = NULL) {
+    const size_t cloud_size = input.size();
+
+    // Size the table so the load factor stays below 0.5; the vectors are
+    // persistent, so steady-state scans reallocate nothing
+    size_t capacity = 64;
+    while (capacity < 2 * cloud_size) {
+      capacity <<= 1;
+    }
+    const uint64_t mask = capacity - 1;
+    keys_.assign(capacity, kEmptyKey);
+    if (sums_.size() < kFieldCount * capacity) {
+      sums_.resize(kFieldCount * capacity);
+    }
+    if (counts_.size() < capacity) {
+      counts_.resize(capacity);
+    }
+    used_slots_.clear();
+
+    const float inv_leaf = 1.0f / leaf_size_;
+#if defined(__SSE2__)
+    const __m128 inv_leaf_v = _mm_set1_ps(inv_leaf);
+#endif
+    if (stride < 1.0) {
+      stride = 1.0;
+    }
+    const bool b_crop = (body_crop != NULL && body_crop->Enabled());
+
+    for (double cursor = 0.0; cursor < cloud_size; cursor += stride) {
+      const PointT& point = input[static_cast<size_t>(cursor)];
+      if (!std::isfinite(point.x) || !std::isfinite(point.y) ||
+          !std::isfinite(point.z)) {
+        continue;
+      }
+      if (b_crop && body_crop->Contains(point)) {
+        continue;
+      }
+
+      int32_t ijk[4];
+#if defined(__SSE2__)
+      // point.data is the 16-byte aligned x/y/z/pad block of the point
+      __m128 scaled = _mm_mul_ps(_mm_load_ps(point.data), inv_leaf_v);
+      // Truncate, then subtract 1 where truncation rounded up (negatives)
+      // to get floor semantics
+      __m128i truncated = _mm_cvttps_epi32(scaled);
+      __m128i correction = _mm_and_si128(
+          _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(truncated), scaled)),
+          _mm_set1_epi32(1));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(ijk),
+                       _mm_sub_epi32(truncated, correction));
+#else
+      ijk[0] = static_cast<int32_t>(std::floor(point.x * inv_leaf));
+      ijk[1] = static_cast<int32_t>(std::floor(point.y * inv_leaf));
+      ijk[2] = static_cast<int32_t>(std::floor(point.z * inv_leaf));
+#endif
+      // Pack the three voxel indices into one 64 bit key (21 bits each)
+      const uint64_t key =
+          (static_cast<uint64_t>(static_cast<uint32_t>(ijk[0] + kIndexOffset) &
+                                 0x1FFFFF)
+           << 42) |
+          (static_cast<uint64_t>(static_cast<uint32_t>(ijk[1] + kIndexOffset) &
+                                 0x1FFFFF)
+           << 21) |
+          static_cast<uint64_t>(static_cast<uint32_t>(ijk[2] + kIndexOffset) &
+                                0x1FFFFF);
+
+      // Linear probing
+      uint64_t slot = HashKey(key) & mask;
+      while (keys_[slot] != key) {
+        if (keys_[slot] == kEmptyKey) {
+          keys_[slot] = key;
+          counts_[slot] = 0;
+          for (int f = 0; f < kFieldCount; f++) {
+            sums_[kFieldCount * slot + f] = 0.0f;
+          }
+          used_slots_.push_back(slot);
+          break;
+        }
+        slot = (slot + 1) & mask;
+      }
+
+      float* sums = &sums_[kFieldCount * slot];
+      sums[0] += point.x;
+      sums[1] += point.y;
+      sums[2] += point.z;
+      AddExtraFields(point, sums, 0);
+      counts_[slot]++;
+    }
+
+    // Emit one centroid per occupied voxel. Build into a scratch cloud so
+    // input and output may alias
+    scratch_.clear();
+    scratch_.header = input.header;
+    scratch_.reserve(used_slots_.size());
+    PointT centroid;
+    for (size_t i = 0; i < used_slots_.size(); i++) {
+      const size_t slot = used_slots_[i];
+      const float* sums = &sums_[kFieldCount * slot];
+      const float inv_count = 1.0f / static_cast<float>(counts_[slot]);
+      centroid.x = sums[0] * inv_count;
+      centroid.y = sums[1] * inv_count;
+      centroid.z = sums[2] * inv_count;
+      WriteExtraFields(centroid, sums, inv_count, 0);
+      scratch_.push_back(centroid);
+    }
+    scratch_.width = scratch_.size();
+    scratch_.height = 1;
+    scratch_.is_dense = true;
+    output.swap(scratch_);
+  }
+
+private:
+  // x, y, z, intensity, normal_x, normal_y, normal_z, curvature
+  static const int kFieldCount = 8;
+  static const int32_t kIndexOffset = 1 << 20;
+  static const uint64_t kEmptyKey = ~0ull;
+
+  static inline uint64_t HashKey(uint64_t key) {
+    // splitmix64 finalizer
+    key += 0x9e3779b97f4a7c15ull;
+    key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9ull;
+    key = (key ^ (key >> 27)) * 0x94d049bb133111ebull;
+    return key ^ (key >> 31);
+  }
+
+  // The extra-field helpers resolve at compile time to the fields the point
+  // type actually has (intensity, and normals for PointXYZINormal); the
+  // trailing int/long parameter is only there to rank the overloads
+  template <typename T>
+  static inline auto AddIntensity(const T& point, float* sums, int)
+      -> decltype(static_cast<void>(point.intensity)) {
+    sums[3] += point.intensity;
+  }
+  template <typename T>
+  static inline void AddIntensity(const T&, float*, long) {}
+
+  template <typename T>
+  static inline auto AddNormals(const T& point, float* sums, int)
+      -> decltype(static_cast<void>(point.normal_x)) {
+    sums[4] += point.normal_x;
+    sums[5] += point.normal_y;
+    sums[6] += point.normal_z;
+    sums[7] += point.curvature;
+  }
+  template <typename T>
+  static inline void AddNormals(const T&, float*, long) {}
+
+  template <typename T>
+  static inline void AddExtraFields(const T& point, float* sums, int rank) {
+    AddIntensity(point, sums, rank);
+    AddNormals(point, sums, rank);
+  }
+
+  template <typename T>
+  static inline auto
+  WriteIntensity(T& point, const float* sums, float inv_count, int)
+      -> decltype(static_cast<void>(point.intensity)) {
+    point.intensity = sums[3] * inv_count;
+  }
+  template <typename T>
+  static inline void WriteIntensity(T&, const float*, float, long) {}
+
+  template <typename T>
+  static inline auto
+  WriteNormals(T& point, const float* sums, float inv_count, int)
+      -> decltype(static_cast<void>(point.normal_x)) {
+    point.normal_x = sums[4] * inv_count;
+    point.normal_y = sums[5] * inv_count;
+    point.normal_z = sums[6] * inv_count;
+    point.curvature = sums[7] * inv_count;
+  }
+  template <typename T>
+  static inline void WriteNormals(T&, const float*, float, long) {}
+
+  template <typename T>
+  static inline void
+  WriteExtraFields(T& point, const float* sums, float inv_count, int rank) {
+    WriteIntensity(point, sums, inv_count, rank);
+    WriteNormals(point, sums, inv_count, rank);
+  }
+
+  float leaf_size_;
+
+  // Open-addressing table: per-slot voxel key, SoA field sums and counts
+  std::vector<uint64_t> keys_;
+  std::vector<float> sums_;
+  std::vector<int> counts_;
+  std::vector<uint32_t> used_slots_;
+  pcl::PointCloud<PointT> scratch_;
+};
+
+} // namespace point_cloud_filter
+
+#endif
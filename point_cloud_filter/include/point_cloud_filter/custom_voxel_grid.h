@@ -10,6 +10,8 @@
 // Dynamic reconfigure
 #include <point_cloud_filter/CustomVoxelGridConfig.h>
 
+#include <point_cloud_filter/VoxelHashGrid.h>
+
 namespace point_cloud_filter {
 /** \brief @b VoxelGrid assembles a local 3D grid over a given PointCloud, and
  * downsamples + filters the data. \author Radu Bogdan Rusu
@@ -21,9 +23,19 @@ protected:
       point_cloud_filter::CustomVoxelGridConfig>>
       srv_;
 
-  /** \brief The PCL filter implementation used. */
+  /** \brief The PCL filter implementation used. Kept as the holder of the
+   * leaf size (driven by dynamic reconfigure and the change_leaf_size topic)
+   * and as the fallback for clouds the hash grid cannot handle. */
   pcl::VoxelGrid<pcl::PCLPointCloud2> impl_;
 
+  /** \brief Hash-based voxel grid used instead of the sort-based impl_ for
+   * plain XYZ/XYZI clouds with no passthrough filtering configured. */
+  VoxelHashGrid<pcl::PointXYZI> hash_grid_;
+
+  /** \brief Whether the input layout and the configured filtering options
+   * allow the hash grid fast path. */
+  bool CanUseHashGrid(const pcl::PCLPointCloud2& cloud) const;
+
   /** \brief Call the actual filter.
    * \param input the input point cloud dataset
    * \param indices the input set of indices to use from \a input
@@ -33,10 +33,23 @@ protected:
   void config_callback(point_cloud_filter::NormalComputationConfig& config,
                        uint32_t level);
 
+  /** \brief Whether the message buffer already has the pcl::PointXYZI memory
+   * layout, so it can be copied into the input cloud with one memcpy instead
+   * of a field-wise conversion. */
+  bool CanMemcpyToPointXYZI(const PointCloud2& cloud) const;
+
 private:
   pcl::search::KdTree<pcl::PointXYZI>::Ptr search_method_;
   pcl::NormalEstimationOMP<pcl::PointXYZI, pcl::Normal> norm_est_;
   SearchNormalsMethod normal_search_method_;
+
+  // Number of threads the merge loop shares with the normal estimation
+  int num_threads_ = 1;
+
+  // Persistent clouds so steady-state scans reallocate nothing
+  PointCloud::Ptr input_cloud_;
+  Normals normals_;
+  PointCloudNormal output_cloud_;
 };
 
 } // namespace point_cloud_filter
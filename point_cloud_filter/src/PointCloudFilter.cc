@@ -36,6 +36,10 @@
 
 #include <point_cloud_filter/PointCloudFilter.h>
 
+#include <algorithm>
+
+#include <omp.h>
+
 namespace pu = parameter_utils;
 
 PointCloudFilter::PointCloudFilter() {}
@@ -51,6 +55,8 @@ bool PointCloudFilter::Initialize(const ros::NodeHandle& n) {
 }
 
 bool PointCloudFilter::LoadParameters(const ros::NodeHandle& n) {
+  if (!pu::Get("filtering/fused_filter", params_.fused_filter))
+    return false;
   if (!pu::Get("filtering/grid_filter", params_.grid_filter))
     return false;
   if (!pu::Get("filtering/grid_res", params_.grid_res))
@@ -76,6 +82,39 @@ bool PointCloudFilter::LoadParameters(const ros::NodeHandle& n) {
     return false;
   if (!pu::Get("filtering/extract_features", params_.extract_features))
     return false;
+  if (!pu::Get("filtering/num_threads", params_.num_threads))
+    return false;
+
+  // Body box the crop kernel drops self-hit points from, fused into the
+  // passes below instead of running as the standalone body filter nodelet
+  bool b_body_filter;
+  double body_min_x, body_max_x, body_min_y, body_max_y, body_min_z,
+      body_max_z, body_rotation;
+  if (!pu::Get("filtering/body_filter/enabled", b_body_filter))
+    return false;
+  if (!pu::Get("filtering/body_filter/min_x", body_min_x))
+    return false;
+  if (!pu::Get("filtering/body_filter/max_x", body_max_x))
+    return false;
+  if (!pu::Get("filtering/body_filter/min_y", body_min_y))
+    return false;
+  if (!pu::Get("filtering/body_filter/max_y", body_max_y))
+    return false;
+  if (!pu::Get("filtering/body_filter/min_z", body_min_z))
+    return false;
+  if (!pu::Get("filtering/body_filter/max_z", body_max_z))
+    return false;
+  if (!pu::Get("filtering/body_filter/rotation", body_rotation))
+    return false;
+  body_crop_.Configure(b_body_filter,
+                       static_cast<float>(body_min_x),
+                       static_cast<float>(body_max_x),
+                       static_cast<float>(body_min_y),
+                       static_cast<float>(body_max_y),
+                       static_cast<float>(body_min_z),
+                       static_cast<float>(body_max_z),
+                       static_cast<float>(body_rotation));
+
   // Cap to [0.0, 1.0].
   params_.decimate_percentage =
       std::min(1.0, std::max(0.0, params_.decimate_percentage));
@@ -90,37 +129,48 @@ bool PointCloudFilter::Filter(const PointCloudF::ConstPtr& points,
     return false;
   }
 
-  // Copy input points
-  *points_filtered = *points;
   if (!params_.extract_features) {
-    // Apply a random downsampling filter to the incoming point cloud
-    if (params_.random_filter) {
-      /*-----------------
-      Open space detector
-      NOTE: this would take place only if random_filter is enabled in yaml
-      ------------------*/
-      int n_points;
-      if (b_is_open_space) {
-        n_points =
-            static_cast<int>((1.0 - params_.decimate_percentage_open_space) *
-                             points_filtered->size());
-      } else {
-        n_points = static_cast<int>((1.0 - params_.decimate_percentage) *
-                                    points_filtered->size());
+    if (params_.fused_filter &&
+        (params_.random_filter || params_.grid_filter)) {
+      // Decimate and voxelize in a single traversal of the input, writing
+      // straight into the output buffer with no intermediate copies
+      FusedDecimateAndVoxelize(*points, *points_filtered, b_is_open_space);
+    } else {
+      // Copy input points
+      *points_filtered = *points;
+
+      // Drop robot self-hit points in place before the downsampling stages
+      if (body_crop_.Enabled()) {
+        body_crop_.Crop(*points_filtered);
       }
 
-      pcl::RandomSample<PointF> random_filter;
-      random_filter.setSample(n_points);
-      random_filter.setInputCloud(points_filtered);
-      random_filter.filter(*points_filtered);
-    }
+      // Apply a random downsampling filter to the incoming point cloud
+      if (params_.random_filter) {
+        /*-----------------
+        Open space detector
+        NOTE: this would take place only if random_filter is enabled in yaml
+        ------------------*/
+        int n_points;
+        if (b_is_open_space) {
+          n_points =
+              static_cast<int>((1.0 - params_.decimate_percentage_open_space) *
+                               points_filtered->size());
+        } else {
+          n_points = static_cast<int>((1.0 - params_.decimate_percentage) *
+                                      points_filtered->size());
+        }
 
-    // Apply a voxel grid filter to the incoming point cloud
-    if (params_.grid_filter) {
-      pcl::VoxelGrid<PointF> grid;
-      grid.setLeafSize(params_.grid_res, params_.grid_res, params_.grid_res);
-      grid.setInputCloud(points_filtered);
-      grid.filter(*points_filtered);
+        pcl::RandomSample<PointF> random_filter;
+        random_filter.setSample(n_points);
+        random_filter.setInputCloud(points_filtered);
+        random_filter.filter(*points_filtered);
+      }
+
+      // Apply a voxel grid filter to the incoming point cloud
+      if (params_.grid_filter) {
+        voxel_hash_grid_.SetLeafSize(params_.grid_res);
+        voxel_hash_grid_.Downsample(*points_filtered, *points_filtered);
+      }
     }
 
     // Remove statistical outliers in incoming the point cloud
@@ -145,7 +195,7 @@ bool PointCloudFilter::Filter(const PointCloudF::ConstPtr& points,
     // Downsample point cloud by extracting features
     // Arrange points in scan lines
     // Todo: the VLP scan period should be a parameter set by user
-    arrangePCLInScanLines(*points_filtered, 0.1);
+    arrangePCLInScanLines(*points, 0.1);
 
     // Extract features from the arranged points
     extractFeatures();
@@ -155,7 +205,7 @@ bool PointCloudFilter::Filter(const PointCloudF::ConstPtr& points,
     pcld_temp += cornerPointsLessSharp_;
     pcld_temp += surfacePointsFlat_;
     pcld_temp += surfacePointsLessFlat_;
-    pcld_temp.header = points_filtered->header;
+    pcld_temp.header = points->header;
 
     Eigen::Affine3f transform = Eigen::Affine3f::Identity();
 
@@ -175,6 +225,52 @@ bool PointCloudFilter::Filter(const PointCloudF::ConstPtr& points,
   return true;
 }
 
+void PointCloudFilter::FusedDecimateAndVoxelize(const PointCloudF& points,
+                                                PointCloudF& points_filtered,
+                                                const bool b_is_open_space) {
+  // The random sampling stage is approximated by a uniform stride over the
+  // scan, which keeps the same fraction of points without a second pass
+  double step = 1.0;
+  if (params_.random_filter) {
+    double decimate_percentage = b_is_open_space
+        ? params_.decimate_percentage_open_space
+        : params_.decimate_percentage;
+    double keep_ratio = 1.0 - decimate_percentage;
+    if (keep_ratio <= 0.0) {
+      points_filtered.clear();
+      points_filtered.header = points.header;
+      return;
+    }
+    step = 1.0 / keep_ratio;
+  }
+
+  const size_t cloud_size = points.size();
+
+  const bool b_crop = body_crop_.Enabled();
+
+  if (!params_.grid_filter) {
+    // Stride-only decimation, with the body crop folded into the same pass
+    points_filtered.clear();
+    points_filtered.header = points.header;
+    points_filtered.reserve(static_cast<size_t>(cloud_size / step) + 1);
+    for (double cursor = 0.0; cursor < cloud_size; cursor += step) {
+      const PointF& point = points[static_cast<size_t>(cursor)];
+      if (b_crop && body_crop_.Contains(point)) {
+        continue;
+      }
+      points_filtered.push_back(point);
+    }
+    return;
+  }
+
+  // Accumulate the surviving points directly into voxel centroids; the
+  // stride folds the decimation stage into the same traversal and the body
+  // crop is tested on each point before it is accumulated
+  voxel_hash_grid_.SetLeafSize(params_.grid_res);
+  voxel_hash_grid_.Downsample(
+      points, points_filtered, step, b_crop ? &body_crop_ : NULL);
+}
+
 // Arrange the pointcloud in Scanlines
 void PointCloudFilter::arrangePCLInScanLines(const PointCloudF& laserCloudIn,
                                              float scanPeriod) {
@@ -196,9 +292,16 @@ void PointCloudFilter::arrangePCLInScanLines(const PointCloudF& laserCloudIn,
   PointF point;
   laserCloudScans_.clear();
   laserCloudScans_.resize(nScanRings_);
+  const bool b_crop = body_crop_.Enabled();
 
   // Extract valid points from input cloud
   for (int i = 0; i < cloudSize; i++) {
+    // Drop robot self-hit points; tested in the input frame, before the
+    // axis reshuffle below
+    if (b_crop && body_crop_.Contains(laserCloudIn[i])) {
+      continue;
+    }
+
     point.x = laserCloudIn[i].y;
     point.y = laserCloudIn[i].z;
     point.z = laserCloudIn[i].x;
@@ -272,127 +375,174 @@ void PointCloudFilter::extractFeatures(const uint16_t& beginIdx) {
   cornerPointsLessSharp_.clear();
   surfacePointsFlat_.clear();
   surfacePointsLessFlat_.clear();
-  regionCurvature_.clear();
-  regionLabel_.clear();
-  regionSortIndices_.clear();
-  scanNeighborPicked_.clear();
 
-  // Extract features from individual scans
+  // Extract features from individual scans. Every ring only touches its own
+  // slice of laserCloud_ and its own scratch buffers, so the rings are
+  // spread over the configured threads
   size_t nScans = scanIndices_.size();
+  std::vector<RingFeatures> ringFeatures(nScans);
+
+  int enable_omp = (1 < params_.num_threads);
+#pragma omp parallel num_threads(params_.num_threads) if (enable_omp)
+  {
+    // Per-thread scratch, reused across the rings the thread processes
+    RegionBuffers region;
+    std::vector<int> scanNeighborPicked;
+
+#pragma omp for schedule(dynamic, 1)
+    for (size_t i = beginIdx; i < nScans; i++) {
+      size_t scanStartIdx = scanIndices_[i].first;
+      size_t scanEndIdx = scanIndices_[i].second;
+
+      // Skip empty scans
+      if (scanEndIdx <= scanStartIdx + 2 * feature_config_.curvatureRegion) {
+        continue;
+      }
+
+      extractFeaturesFromScan(
+          scanStartIdx, scanEndIdx, region, scanNeighborPicked, ringFeatures[i]);
+    }
+  }
+
+  // Merge the per-ring clouds in ring order so the output is identical for
+  // any thread count
   for (size_t i = beginIdx; i < nScans; i++) {
-    PointCloudF::Ptr surfPointsLessFlatScan(new PointCloudF);
-    size_t scanStartIdx = scanIndices_[i].first;
-    size_t scanEndIdx = scanIndices_[i].second;
+    cornerPointsSharp_ += ringFeatures[i].cornerSharp;
+    cornerPointsLessSharp_ += ringFeatures[i].cornerLessSharp;
+    surfacePointsFlat_ += ringFeatures[i].surfaceFlat;
+    surfacePointsLessFlat_ += ringFeatures[i].surfaceLessFlat;
+  }
+}
 
-    // Skip empty scans
-    if (scanEndIdx <= scanStartIdx + 2 * feature_config_.curvatureRegion) {
+void PointCloudFilter::extractFeaturesFromScan(
+    const size_t scanStartIdx,
+    const size_t scanEndIdx,
+    RegionBuffers& region,
+    std::vector<int>& scanNeighborPicked,
+    RingFeatures& features) {
+  // Preallocate the per-ring clouds to the configured feature caps so the
+  // picking loops never reallocate
+  features.cornerSharp.reserve(feature_config_.maxCornerSharp *
+                               feature_config_.nFeatureRegions);
+  features.cornerLessSharp.reserve(feature_config_.maxCornerLessSharp *
+                                   feature_config_.nFeatureRegions);
+  features.surfaceFlat.reserve(feature_config_.maxSurfaceFlat *
+                               feature_config_.nFeatureRegions);
+
+  PointCloudF::Ptr surfPointsLessFlatScan(new PointCloudF);
+  surfPointsLessFlatScan->reserve(scanEndIdx - scanStartIdx + 1);
+
+  // Reset scan buffers
+  setScanBuffersFor(scanStartIdx, scanEndIdx, scanNeighborPicked);
+
+  // Extract features from equally sized scan regions
+  for (int j = 0; j < feature_config_.nFeatureRegions; j++) {
+    size_t sp = ((scanStartIdx + feature_config_.curvatureRegion) *
+                     (feature_config_.nFeatureRegions - j) +
+                 (scanEndIdx - feature_config_.curvatureRegion) * j) /
+        feature_config_.nFeatureRegions;
+    size_t ep = ((scanStartIdx + feature_config_.curvatureRegion) *
+                     (feature_config_.nFeatureRegions - 1 - j) +
+                 (scanEndIdx - feature_config_.curvatureRegion) * (j + 1)) /
+            feature_config_.nFeatureRegions -
+        1;
+
+    // Skip empty regions
+    if (ep <= sp) {
       continue;
     }
 
-    // Reset scan buffers
-    setScanBuffersFor(scanStartIdx, scanEndIdx);
-
-    // Extract features from equally sized scan regions
-    for (int j = 0; j < feature_config_.nFeatureRegions; j++) {
-      size_t sp = ((scanStartIdx + feature_config_.curvatureRegion) *
-                       (feature_config_.nFeatureRegions - j) +
-                   (scanEndIdx - feature_config_.curvatureRegion) * j) /
-          feature_config_.nFeatureRegions;
-      size_t ep = ((scanStartIdx + feature_config_.curvatureRegion) *
-                       (feature_config_.nFeatureRegions - 1 - j) +
-                   (scanEndIdx - feature_config_.curvatureRegion) * (j + 1)) /
-              feature_config_.nFeatureRegions -
-          1;
-
-      // Skip empty regions
-      if (ep <= sp) {
-        continue;
-      }
-
-      size_t regionSize = ep - sp + 1;
-
-      // Reset region buffers
-      setRegionBuffersFor(sp, ep);
-      // Calculate the curvature for points in the scans
-      // Extract corner features
-      int largestPickedNum = 0;
-      for (size_t k = regionSize;
-           k > 0 && largestPickedNum < feature_config_.maxCornerLessSharp;) {
-        size_t idx = regionSortIndices_[--k];
-        size_t scanIdx = idx - scanStartIdx;
-        size_t regionIdx = idx - sp;
-
-        // Pick sharp points, the sharp and less sharp need to be above
-        // "surfaceCurvatureThreshold" Technically there is no difference
-        // between the two. Some of them are marked are sharp to reduce data for
-        // laser odometry
-        if (scanNeighborPicked_[scanIdx] == 0 &&
-            regionCurvature_[regionIdx] >
-                feature_config_.surfaceCurvatureThreshold) {
-          largestPickedNum++;
-          if (largestPickedNum <= feature_config_.maxCornerSharp) {
-            regionLabel_[regionIdx] = CORNER_SHARP;
-            cornerPointsSharp_.push_back(laserCloud_[idx]);
-          } else {
-            regionLabel_[regionIdx] = CORNER_LESS_SHARP;
-          }
-          cornerPointsLessSharp_.push_back(laserCloud_[idx]);
-
-          markAsPicked(idx, scanIdx);
+    size_t regionSize = ep - sp + 1;
+
+    // Reset region buffers
+    setRegionBuffersFor(sp, ep, region);
+    // Calculate the curvature for points in the scans
+    // Extract corner features
+    int largestPickedNum = 0;
+    for (size_t k = 0; k < region.cornerCandidates.size() &&
+         largestPickedNum < feature_config_.maxCornerLessSharp;
+         k++) {
+      size_t idx = region.cornerCandidates[k];
+      size_t scanIdx = idx - scanStartIdx;
+      size_t regionIdx = idx - sp;
+
+      // Pick sharp points, the sharp and less sharp need to be above
+      // "surfaceCurvatureThreshold" Technically there is no difference
+      // between the two. Some of them are marked are sharp to reduce data for
+      // laser odometry
+      if (scanNeighborPicked[scanIdx] == 0 &&
+          region.curvature[regionIdx] >
+              feature_config_.surfaceCurvatureThreshold) {
+        largestPickedNum++;
+        // Carry the label in the curvature field so downstream consumers
+        // (the loam registration backend) can split edges from surfaces
+        PointF featurePoint = laserCloud_[idx];
+        if (largestPickedNum <= feature_config_.maxCornerSharp) {
+          region.label[regionIdx] = CORNER_SHARP;
+          featurePoint.curvature = CORNER_SHARP;
+          features.cornerSharp.push_back(featurePoint);
+        } else {
+          region.label[regionIdx] = CORNER_LESS_SHARP;
+          featurePoint.curvature = CORNER_LESS_SHARP;
         }
-      }
+        features.cornerLessSharp.push_back(featurePoint);
 
-      // Extract flat surface features
-      // A certain number of points that are less than
-      // "surfaceCurvatureThreshold" are marked as Flat
-      int smallestPickedNum = 0;
-      for (int k = 0;
-           k < regionSize && smallestPickedNum < feature_config_.maxSurfaceFlat;
-           k++) {
-        size_t idx = regionSortIndices_[k];
-        size_t scanIdx = idx - scanStartIdx;
-        size_t regionIdx = idx - sp;
-
-        if (scanNeighborPicked_[scanIdx] == 0 &&
-            regionCurvature_[regionIdx] <
-                feature_config_.surfaceCurvatureThreshold) {
-          smallestPickedNum++;
-          regionLabel_[regionIdx] = SURFACE_FLAT;
-          surfacePointsFlat_.push_back(laserCloud_[idx]);
-
-          markAsPicked(idx, scanIdx);
-        }
+        markAsPicked(idx, scanIdx, scanNeighborPicked);
       }
+    }
 
-      // Extract less flat surface features
-      for (int k = 0; k < regionSize; k++) {
-        if (regionLabel_[k] <= SURFACE_LESS_FLAT) {
-          surfPointsLessFlatScan->push_back(laserCloud_[sp + k]);
-        }
+    // Extract flat surface features
+    // A certain number of points that are less than
+    // "surfaceCurvatureThreshold" are marked as Flat
+    int smallestPickedNum = 0;
+    for (size_t k = 0; k < region.flatCandidates.size() &&
+         smallestPickedNum < feature_config_.maxSurfaceFlat;
+         k++) {
+      size_t idx = region.flatCandidates[k];
+      size_t scanIdx = idx - scanStartIdx;
+      size_t regionIdx = idx - sp;
+
+      if (scanNeighborPicked[scanIdx] == 0 &&
+          region.curvature[regionIdx] <
+              feature_config_.surfaceCurvatureThreshold) {
+        smallestPickedNum++;
+        region.label[regionIdx] = SURFACE_FLAT;
+        PointF featurePoint = laserCloud_[idx];
+        featurePoint.curvature = SURFACE_FLAT;
+        features.surfaceFlat.push_back(featurePoint);
+
+        markAsPicked(idx, scanIdx, scanNeighborPicked);
       }
     }
 
-    // Down size less flat surface point cloud of current scan
-    PointCloudF surfPointsLessFlatScanDS;
-    pcl::VoxelGrid<PointF> downSizeFilter;
-    downSizeFilter.setInputCloud(surfPointsLessFlatScan);
-    downSizeFilter.setLeafSize(feature_config_.lessFlatFilterSize,
-                               feature_config_.lessFlatFilterSize,
-                               feature_config_.lessFlatFilterSize);
-    downSizeFilter.filter(surfPointsLessFlatScanDS);
-
-    surfacePointsLessFlat_ += surfPointsLessFlatScanDS;
+    // Extract less flat surface features
+    for (size_t k = 0; k < regionSize; k++) {
+      if (region.label[k] <= SURFACE_LESS_FLAT) {
+        PointF featurePoint = laserCloud_[sp + k];
+        featurePoint.curvature = region.label[k];
+        surfPointsLessFlatScan->push_back(featurePoint);
+      }
+    }
   }
+
+  // Down size less flat surface point cloud of current scan
+  pcl::VoxelGrid<PointF> downSizeFilter;
+  downSizeFilter.setInputCloud(surfPointsLessFlatScan);
+  downSizeFilter.setLeafSize(feature_config_.lessFlatFilterSize,
+                             feature_config_.lessFlatFilterSize,
+                             feature_config_.lessFlatFilterSize);
+  downSizeFilter.filter(features.surfaceLessFlat);
 }
 
 void PointCloudFilter::setRegionBuffersFor(const size_t& startIdx,
-                                           const size_t& endIdx) {
+                                           const size_t& endIdx,
+                                           RegionBuffers& region) {
   // Resize buffers
   size_t regionSize = endIdx - startIdx + 1;
-  regionCurvature_.resize(regionSize);
-  regionSortIndices_.resize(regionSize);
+  region.curvature.resize(regionSize);
+  region.sortIndices.resize(regionSize);
   // Initially every point is considered a SURFACE_LESS_FLAT
-  regionLabel_.assign(regionSize, SURFACE_LESS_FLAT);
+  region.label.assign(regionSize, SURFACE_LESS_FLAT);
 
   // Calculate point curvatures and reset sort indices
   // Looping through # number of neighbor points(curvatureRegion) and calculate
@@ -410,26 +560,58 @@ void PointCloudFilter::setRegionBuffersFor(const size_t& startIdx,
       diffZ += laserCloud_[i + j].z + laserCloud_[i - j].z;
     }
 
-    regionCurvature_[regionIdx] = diffX * diffX + diffY * diffY + diffZ * diffZ;
-    regionSortIndices_[regionIdx] = i;
+    region.curvature[regionIdx] = diffX * diffX + diffY * diffY + diffZ * diffZ;
+    region.sortIndices[regionIdx] = i;
   }
 
-  // Sort point curvatures
-  for (size_t i = 1; i < regionSize; i++) {
-    for (size_t j = i; j >= 1; j--) {
-      if (regionCurvature_[regionSortIndices_[j] - startIdx] <
-          regionCurvature_[regionSortIndices_[j - 1] - startIdx]) {
-        std::swap(regionSortIndices_[j], regionSortIndices_[j - 1]);
-      }
-    }
-  }
+  // Partial top-k/bottom-k selection instead of a full O(n^2) sort. The
+  // picking loops skip candidates whose neighborhood was already picked,
+  // and every pick suppresses up to curvatureRegion neighbors on each
+  // side, so the pools carry the worst-case suppression on top of the pick
+  // budgets (clamped to the region size): that way the loops can always
+  // scan deeper past suppressed candidates, like the fully sorted order
+  // allowed
+  const size_t suppressionMargin =
+      static_cast<size_t>(feature_config_.maxCornerLessSharp +
+                          feature_config_.maxSurfaceFlat) *
+      2 * feature_config_.curvatureRegion;
+  const size_t nCorner = std::min(
+      regionSize,
+      static_cast<size_t>(feature_config_.maxCornerLessSharp) +
+          suppressionMargin);
+  const size_t nFlat = std::min(
+      regionSize,
+      static_cast<size_t>(feature_config_.maxSurfaceFlat) + suppressionMargin);
+
+  region.cornerCandidates.assign(region.sortIndices.begin(),
+                                 region.sortIndices.end());
+  std::partial_sort(region.cornerCandidates.begin(),
+                    region.cornerCandidates.begin() + nCorner,
+                    region.cornerCandidates.end(),
+                    [this, &region, startIdx](size_t a, size_t b) {
+                      return region.curvature[a - startIdx] >
+                          region.curvature[b - startIdx];
+                    });
+  region.cornerCandidates.resize(nCorner);
+
+  region.flatCandidates.assign(region.sortIndices.begin(),
+                               region.sortIndices.end());
+  std::partial_sort(region.flatCandidates.begin(),
+                    region.flatCandidates.begin() + nFlat,
+                    region.flatCandidates.end(),
+                    [this, &region, startIdx](size_t a, size_t b) {
+                      return region.curvature[a - startIdx] <
+                          region.curvature[b - startIdx];
+                    });
+  region.flatCandidates.resize(nFlat);
 }
 
 void PointCloudFilter::setScanBuffersFor(const size_t& startIdx,
-                                         const size_t& endIdx) {
+                                         const size_t& endIdx,
+                                         std::vector<int>& scanNeighborPicked) {
   // Resize buffers
   size_t scanSize = endIdx - startIdx + 1;
-  scanNeighborPicked_.assign(scanSize, 0);
+  scanNeighborPicked.assign(scanSize, 0);
 
   // Mark unreliable points as picked
   // Points that have depth difference greater than 0.1 meters are set as
@@ -453,8 +635,8 @@ void PointCloudFilter::setScanBuffersFor(const size_t& startIdx,
             depth2;
 
         if (weighted_distance < 0.1) {
-          std::fill_n(&scanNeighborPicked_[i - startIdx -
-                                           feature_config_.curvatureRegion],
+          std::fill_n(&scanNeighborPicked[i - startIdx -
+                                          feature_config_.curvatureRegion],
                       feature_config_.curvatureRegion + 1,
                       1);
 
@@ -466,7 +648,7 @@ void PointCloudFilter::setScanBuffersFor(const size_t& startIdx,
             depth1;
 
         if (weighted_distance < 0.1) {
-          std::fill_n(&scanNeighborPicked_[i - startIdx + 1],
+          std::fill_n(&scanNeighborPicked[i - startIdx + 1],
                       feature_config_.curvatureRegion + 1,
                       1);
         }
@@ -480,14 +662,15 @@ void PointCloudFilter::setScanBuffersFor(const size_t& startIdx,
     // and its neighbors is outside a bound i.e. rejecting very sharp ramp like
     // points
     if (diffNext > 0.0002 * dis && diffPrevious > 0.0002 * dis) {
-      scanNeighborPicked_[i - startIdx] = 1;
+      scanNeighborPicked[i - startIdx] = 1;
     }
   }
 }
 
 void PointCloudFilter::markAsPicked(const size_t& cloudIdx,
-                                    const size_t& scanIdx) {
-  scanNeighborPicked_[scanIdx] = 1;
+                                    const size_t& scanIdx,
+                                    std::vector<int>& scanNeighborPicked) {
+  scanNeighborPicked[scanIdx] = 1;
 
   // Not only mark the point as picked but mark all the points
   // used in the curvatureRegion around it as picked as well
@@ -497,7 +680,7 @@ void PointCloudFilter::markAsPicked(const size_t& cloudIdx,
       break;
     }
 
-    scanNeighborPicked_[scanIdx + i] = 1;
+    scanNeighborPicked[scanIdx + i] = 1;
   }
 
   for (int i = 1; i <= feature_config_.curvatureRegion; i++) {
@@ -506,7 +689,7 @@ void PointCloudFilter::markAsPicked(const size_t& cloudIdx,
       break;
     }
 
-    scanNeighborPicked_[scanIdx - i] = 1;
+    scanNeighborPicked[scanIdx - i] = 1;
   }
 }
 
@@ -72,6 +72,31 @@ void CustomVoxelGrid::ChangeLeafSizeRostopic(
   }
 }
 
+//////////////////////////////////////////////////////////////////////////////////////////////
+bool CustomVoxelGrid::CanUseHashGrid(const pcl::PCLPointCloud2& cloud) const {
+  // The hash grid handles the plain lidar layout (x/y/z plus optionally
+  // intensity, all float) and no passthrough filtering. Anything else falls
+  // back to the PCLPointCloud2 implementation
+  if (!impl_.getFilterFieldName().empty()) {
+    return false;
+  }
+  int matched_fields = 0;
+  for (size_t i = 0; i < cloud.fields.size(); i++) {
+    const std::string& name = cloud.fields[i].name;
+    if (name == "_") { // padding
+      continue;
+    }
+    if (name != "x" && name != "y" && name != "z" && name != "intensity") {
+      return false;
+    }
+    if (cloud.fields[i].datatype != pcl::PCLPointField::FLOAT32) {
+      return false;
+    }
+    matched_fields++;
+  }
+  return matched_fields == 4;
+}
+
 //////////////////////////////////////////////////////////////////////////////////////////////
 void CustomVoxelGrid::filter(const PointCloud2::ConstPtr& input,
                              const IndicesPtr& indices,
@@ -79,6 +104,20 @@ void CustomVoxelGrid::filter(const PointCloud2::ConstPtr& input,
   boost::mutex::scoped_lock lock(mutex_);
   pcl::PCLPointCloud2::Ptr pcl_input(new pcl::PCLPointCloud2);
   pcl_conversions::toPCL(*(input), *(pcl_input));
+
+  if (!indices && CanUseHashGrid(*pcl_input)) {
+    pcl::PointCloud<pcl::PointXYZI> cloud;
+    pcl::fromPCLPointCloud2(*pcl_input, cloud);
+    // The leaf size still lives in impl_ so dynamic reconfigure and the
+    // change_leaf_size topic keep working unchanged
+    hash_grid_.SetLeafSize(impl_.getLeafSize()[0]);
+    hash_grid_.Downsample(cloud, cloud);
+    pcl::PCLPointCloud2 pcl_output;
+    pcl::toPCLPointCloud2(cloud, pcl_output);
+    pcl_conversions::moveFromPCL(pcl_output, output);
+    return;
+  }
+
   impl_.setInputCloud(pcl_input);
   impl_.setIndices(indices);
   pcl::PCLPointCloud2 pcl_output;
@@ -5,6 +5,8 @@
  */
 
 #include "point_cloud_filter/normal_computation.h"
+#include <cstddef>
+#include <cstring>
 #include <pluginlib/class_list_macros.h>
 
 namespace point_cloud_filter {
@@ -23,39 +25,96 @@ bool NormalComputation::child_init(ros::NodeHandle& nh, bool& has_service) {
   return true;
 }
 
+bool NormalComputation::CanMemcpyToPointXYZI(const PointCloud2& cloud) const {
+  if (cloud.is_bigendian) {
+    return false;
+  }
+  if (cloud.point_step != sizeof(pcl::PointXYZI)) {
+    return false;
+  }
+  int matched_fields = 0;
+  for (size_t i = 0; i < cloud.fields.size(); i++) {
+    const sensor_msgs::PointField& field = cloud.fields[i];
+    if (field.name == "_") { // padding
+      continue;
+    }
+    if (field.datatype != sensor_msgs::PointField::FLOAT32) {
+      return false;
+    }
+    if ((field.name == "x" && field.offset == offsetof(pcl::PointXYZI, x)) ||
+        (field.name == "y" && field.offset == offsetof(pcl::PointXYZI, y)) ||
+        (field.name == "z" && field.offset == offsetof(pcl::PointXYZI, z)) ||
+        (field.name == "intensity" &&
+         field.offset == offsetof(pcl::PointXYZI, intensity))) {
+      matched_fields++;
+    } else {
+      return false;
+    }
+  }
+  return matched_fields == 4;
+}
+
 void NormalComputation::filter(const PointCloud2::ConstPtr& input,
                                const IndicesPtr& indices,
                                PointCloud2& output) {
-  pcl::PointCloud<pcl::PointXYZI>::Ptr input_cloud(
-      new pcl::PointCloud<pcl::PointXYZI>());
-  pcl::fromROSMsg(*input, *input_cloud);
-
-  Normals::Ptr normals(new Normals());
+  if (!input_cloud_) {
+    input_cloud_.reset(new PointCloud());
+  }
+  const size_t cloud_size =
+      static_cast<size_t>(input->width) * input->height;
+  if (CanMemcpyToPointXYZI(*input)) {
+    // The message buffer already is an array of pcl::PointXYZI: lift it into
+    // the persistent input cloud with one memcpy instead of a field-wise
+    // deserialization
+    input_cloud_->resize(cloud_size);
+    if (cloud_size > 0) {
+      memcpy(&input_cloud_->points[0],
+             input->data.data(),
+             cloud_size * sizeof(pcl::PointXYZI));
+    }
+    pcl_conversions::toPCL(input->header, input_cloud_->header);
+    input_cloud_->width = cloud_size;
+    input_cloud_->height = 1;
+    input_cloud_->is_dense = input->is_dense;
+  } else {
+    pcl::fromROSMsg(*input, *input_cloud_);
+  }
 
-  norm_est_.setInputCloud(input_cloud);
-  norm_est_.compute(*normals);
+  norm_est_.setInputCloud(input_cloud_);
+  norm_est_.compute(normals_);
 
-  PointCloudNormal::Ptr output_cloud_with_normals(new PointCloudNormal());
-  for (size_t i = 0; i < input_cloud->points.size(); i++) {
-    pcl::PointXYZINormal point;
-    point.x = input_cloud->points[i].x;
-    point.y = input_cloud->points[i].y;
-    point.z = input_cloud->points[i].z;
-    point.intensity = input_cloud->points[i].intensity;
-    point.normal_x = normals->at(i).normal_x;
-    point.normal_y = normals->at(i).normal_y;
-    point.normal_z = normals->at(i).normal_z;
-    output_cloud_with_normals->points.push_back(point);
+  // Merge xyz/intensity and the computed normals into the preallocated
+  // output cloud, split across the same thread budget as the estimation
+  output_cloud_.resize(input_cloud_->size());
+  int enable_omp = (1 < num_threads_);
+#pragma omp parallel for num_threads(num_threads_) schedule(static) \
+    if (enable_omp)
+  for (size_t i = 0; i < input_cloud_->size(); i++) {
+    const pcl::PointXYZI& in = input_cloud_->points[i];
+    const pcl::Normal& normal = normals_[i];
+    pcl::PointXYZINormal& point = output_cloud_.points[i];
+    point.x = in.x;
+    point.y = in.y;
+    point.z = in.z;
+    point.intensity = in.intensity;
+    point.normal_x = normal.normal_x;
+    point.normal_y = normal.normal_y;
+    point.normal_z = normal.normal_z;
   }
-  output_cloud_with_normals->header = input_cloud->header;
+  output_cloud_.header = input_cloud_->header;
+  output_cloud_.width = output_cloud_.size();
+  output_cloud_.height = 1;
 
   if (normal_search_method_ == SearchNormalsMethod::RADIUS) {
     std::vector<int> not_used;
     pcl::removeNaNNormalsFromPointCloud(
-        *output_cloud_with_normals, *output_cloud_with_normals, not_used);
+        output_cloud_, output_cloud_, not_used);
   }
 
-  pcl::toROSMsg(*output_cloud_with_normals, output);
+  // Serialize straight into the output message without an intermediate copy
+  pcl::PCLPointCloud2 pcl_output;
+  pcl::toPCLPointCloud2(output_cloud_, pcl_output);
+  pcl_conversions::moveFromPCL(pcl_output, output);
 }
 
 void NormalComputation::config_callback(
@@ -78,6 +137,7 @@ void NormalComputation::config_callback(
     EXIT_FAILURE;
   }
   norm_est_.setNumberOfThreads(config.num_threads);
+  num_threads_ = config.num_threads;
 }
 
 } // namespace point_cloud_filter
@@ -47,6 +47,7 @@
 #include <geometry_utils/GeometryUtilsROS.h>
 #include <geometry_utils/Transform3.h>
 #include <multithreaded_gicp/gicp.h>
+#include <multithreaded_loam/loam.h>
 #include <multithreaded_ndt/ndt_omp.h>
 #include <mutex>
 #include <nav_msgs/Odometry.h>
@@ -85,11 +86,23 @@ public:
   // Store incremental estimate from odometry
   bool MotionUpdate(const geometry_utils::Transform3& incremental_odom);
 
+  // Notify that points were inserted into the map. Advances the map version
+  // the target cache is keyed on, so the next MeasurementUpdate rebuilds the
+  // target kd-tree instead of reusing a stale one
+  void SignalMapUpdate();
+
   // Align incoming point cloud with a reference point cloud from the map.
-  // Output the query scan aligned in the localization frame
-  bool MeasurementUpdate(const PointCloudF::Ptr& query,
-                         const PointCloudF::Ptr& reference,
-                         PointCloudF* aligned_query);
+  // Output the query scan aligned in the localization frame.
+  // query_covariances optionally carries per-point covariances already
+  // derived from the query normals (e.g. by the scan-to-scan stage), so GICP
+  // consumes them directly instead of converting the normals again
+  bool MeasurementUpdate(
+      const PointCloudF::Ptr& query,
+      const PointCloudF::Ptr& reference,
+      PointCloudF* aligned_query,
+      const pcl::MultithreadedGeneralizedIterativeClosestPoint<
+          PointF,
+          PointF>::MatricesVectorPtr& query_covariances = nullptr);
 
   bool
   ComputePoint2PlaneICPCovariance(const PointCloudF& query_cloud,
@@ -144,6 +157,10 @@ public:
 
   void SetFlatGroundAssumptionValue(const bool& value);
 
+  // Change the registration iteration cap at runtime. Used by the latency
+  // controller to trade alignment refinement for callback time
+  void SetMaximumIterations(int iterations);
+
   // Diagnostics
   diagnostic_msgs::DiagnosticStatus GetDiagnostics();
 
@@ -163,6 +180,15 @@ private:
   // Publish observability direction based on ICP of two ptclds
   void PublishObservableDirections(const Eigen::Matrix<double, 6, 6>& A);
 
+  // Rate gate shared by the debug cloud topics: true at most
+  // debug_cloud_publish_rate times per second of scan time
+  bool DebugCloudDue();
+
+  // Publish a debug cloud: skipped without subscribers, decimated when
+  // configured, handed off by shared pointer for intra-process consumers
+  void PublishPoints(const PointCloudF::ConstPtr& points,
+                     const ros::Publisher& pub) const;
+
   // The node's name
   std::string name_;
 
@@ -179,6 +205,9 @@ private:
   // Most recent point cloud time stamp for publishers
   std::atomic<ros::Time> stamp_ = {{ros::Time()}};
 
+  // Scan time before which no debug cloud is published
+  ros::Time next_debug_cloud_stamp_;
+
   // Coordinate frames.
   std::string fixed_frame_id_;
   std::string base_frame_id_;
@@ -196,6 +225,18 @@ private:
     int icp_covariance_method;
     // Max boundd for icp covariance
     double icp_max_covariance;
+    // Use every n-th correspondence when accumulating the covariance
+    // information matrix (1 = use all)
+    int icp_covariance_stride = 1;
+    // Run the full covariance/observability computation only every n-th
+    // scan, propagating the last result in between (1 = every scan)
+    int icp_covariance_recompute_every_n = 1;
+    // Always run the full computation when the incremental translation
+    // exceeds this many meters, regardless of the scan counter (0 = disabled)
+    double icp_covariance_motion_threshold = 0.0;
+    // Cap on the number of correspondences used for the covariance; scans
+    // with more raise the accumulation stride accordingly (0 = no cap)
+    int icp_covariance_max_correspondences = 0;
     // Compute ICP observability
     bool compute_icp_observability;
     // Stop ICP if the transformation from the last iteration was this small
@@ -206,9 +247,29 @@ private:
     // Iterate ICP this many times
     unsigned int iterations;
     // Number of threads GICP is allowed to use
-    int num_threads;
+    int num_threads = 1;
     // Enable GICP timing information print logs
     bool enable_timing_output;
+    // Stream GICP per-point covariances in the compact float SoA layout
+    // instead of double matrices
+    bool b_compact_covariance_storage = false;
+    // Reuse the registration target (kd-tree and covariances) while the map
+    // version and the pose cell are unchanged, instead of rebuilding them
+    // from the extracted neighborhood every scan
+    bool b_enable_target_cache = false;
+    // Edge length in meters of the pose cells the target cache is keyed on
+    double target_cache_cell_size = 1.0;
+    // Publish the query/reference/aligned debug clouds. Nothing is produced
+    // without subscribers even when enabled
+    bool b_publish_debug_clouds = false;
+    // Ceiling on the debug cloud publish rate in Hz
+    double debug_cloud_publish_rate = 1.0;
+    // Keep every n-th point of a published debug cloud (1 = full cloud)
+    int debug_cloud_decimation = 1;
+    // Query and reference are handed in already expressed in the fixed
+    // frame; the alignment result is conjugated back into the sensor-frame
+    // correction the incremental update expects
+    bool b_registration_in_fixed_frame = false;
     // Radius used when computing ptcld normals
     //    double normal_radius_;
     int k_nearest_neighbours_;
@@ -253,6 +314,14 @@ private:
   Eigen::Matrix<double, 6, 6> icp_covariance_;
   double condition_number_;
 
+  // Reduced-rate covariance state: scans since the last full computation,
+  // the covariance and incremental translation it was computed with, and
+  // whether one has been computed at all
+  int scans_since_covariance_update_ = 0;
+  Eigen::Matrix<double, 6, 6> last_computed_icp_covariance_;
+  double covariance_reference_translation_ = 0.0;
+  bool b_has_covariance_ = false;
+
   // Observability matrix
   Eigen::Matrix<double, 6, 6> observability_matrix_;
 
@@ -267,6 +336,25 @@ private:
   // Reductions
   KdTree::Ptr search_tree_;
 
+  // Batched nearest neighbor query against the registration target: fills
+  // correspondences with the index of the closest reference point for every
+  // point of the aligned query, splitting the cloud across
+  // params_.num_threads. The output vector is preallocated and reused across
+  // measurement updates
+  void SearchCorrespondences(const PointCloudF& aligned_query,
+                             std::vector<size_t>* correspondences);
+
+  // Correspondence indices of the latest aligned scan
+  std::vector<size_t> correspondences_;
+
+  // Target cache state: the map version and pose cell the held registration
+  // target was built for, and the reference cloud its kd-tree indexes (kept
+  // alive so correspondence indices stay valid on cache hits)
+  unsigned int map_version_ = 0;
+  unsigned int cached_map_version_ = 0;
+  Eigen::Vector3i cached_pose_cell_ = Eigen::Vector3i::Zero();
+  PointCloudF::Ptr cached_reference_;
+
   /*---
   Mutex
   ---*/
@@ -30,6 +30,20 @@ void normalizePCloud(const pcl::PointCloud<pcl::PointXYZI>& cloud,
 void normalizePCloud(const PointCloudF& cloud,
                      PointCloudF::Ptr pclptr_normalized);
 
+// Accumulates the point-to-plane information matrix Ap = \sum_i (Hi' Hi) with
+// H_i = [ a_i x n_i   n_i ], a_i from the (normalized) query cloud and n_i the
+// normal of its corresponding reference point. Correspondences are gathered
+// into SoA blocks so the pairwise products vectorize, and the 21 unique
+// entries of the symmetric sum are reduced across num_threads threads with
+// per-thread partial sums. A stride > 1 subsamples the correspondences and
+// rescales the result, for when an approximate Ap suffices
+void computeAp_Point2Plane(const PointCloudF& query_normalized,
+                           const PointCloudF& reference_normals,
+                           const std::vector<size_t>& correspondences,
+                           Eigen::Matrix<double, 6, 6>& Ap,
+                           int num_threads = 1,
+                           int stride = 1);
+
 void doEigenDecomp6x6(const Eigen::Matrix<double, 6, 6>& data,
                       Eigen::Matrix<double, 6, 1>& eigenvalues,
                       Eigen::Matrix<double, 6, 6>& eigenvectors);
@@ -7,6 +7,7 @@ Authors:
 */
 
 #include <chrono>
+#include <cmath>
 #include <point_cloud_localization/PointCloudLocalization.h>
 #include <point_cloud_localization/utils.h>
 #include <tf/transform_datatypes.h>
@@ -72,6 +73,18 @@ bool PointCloudLocalization::LoadParameters(const ros::NodeHandle& n) {
     return false;
   if (!pu::Get("localization/icp_max_covariance", params_.icp_max_covariance))
     return false;
+  if (!pu::Get("localization/icp_covariance_stride",
+               params_.icp_covariance_stride))
+    return false;
+  if (!pu::Get("localization/icp_covariance_recompute_every_n",
+               params_.icp_covariance_recompute_every_n))
+    return false;
+  if (!pu::Get("localization/icp_covariance_motion_threshold",
+               params_.icp_covariance_motion_threshold))
+    return false;
+  if (!pu::Get("localization/icp_covariance_max_correspondences",
+               params_.icp_covariance_max_correspondences))
+    return false;
   if (!pu::Get("localization/compute_icp_observability",
                params_.compute_icp_observability))
     return false;
@@ -88,6 +101,27 @@ bool PointCloudLocalization::LoadParameters(const ros::NodeHandle& n) {
   if (!pu::Get("localization/enable_timing_output",
                params_.enable_timing_output))
     return false;
+  if (!pu::Get("localization/b_compact_covariance_storage",
+               params_.b_compact_covariance_storage))
+    return false;
+  if (!pu::Get("localization/b_enable_target_cache",
+               params_.b_enable_target_cache))
+    return false;
+  if (!pu::Get("localization/target_cache_cell_size",
+               params_.target_cache_cell_size))
+    return false;
+  if (!pu::Get("localization/b_publish_debug_clouds",
+               params_.b_publish_debug_clouds))
+    return false;
+  if (!pu::Get("localization/debug_cloud_publish_rate",
+               params_.debug_cloud_publish_rate))
+    return false;
+  if (!pu::Get("localization/debug_cloud_decimation",
+               params_.debug_cloud_decimation))
+    return false;
+  if (!pu::Get("b_registration_in_fixed_frame",
+               params_.b_registration_in_fixed_frame))
+    return false;
   if (!pu::Get("localization/max_translation", max_translation_))
     return false;
   if (!pu::Get("localization/max_rotation", max_rotation_))
@@ -169,6 +203,9 @@ const gu::Transform3& PointCloudLocalization::GetIntegratedEstimate() const {
 void PointCloudLocalization::SetIntegratedEstimate(
     const gu::Transform3& integrated_estimate) {
   integrated_estimate_ = integrated_estimate;
+  // The map is typically regenerated along with an externally set estimate,
+  // so a cached registration target can no longer be trusted
+  map_version_++;
 }
 
 bool PointCloudLocalization::MotionUpdate(
@@ -178,6 +215,10 @@ bool PointCloudLocalization::MotionUpdate(
   return true;
 }
 
+void PointCloudLocalization::SignalMapUpdate() {
+  map_version_++;
+}
+
 bool PointCloudLocalization::TransformPointsToFixedFrame(
     const PointCloudF& points, PointCloudF* points_transformed) const {
   if (points_transformed == NULL) {
@@ -238,6 +279,7 @@ bool PointCloudLocalization::SetupICP() {
     gicp->setMaximumOptimizerIterations(50);
     gicp->setNumThreads(params_.num_threads);
     gicp->enableTimingOutput(params_.enable_timing_output);
+    gicp->setCompactCovarianceStorage(params_.b_compact_covariance_storage);
     gicp->RecomputeTargetCovariance(recompute_covariance_local_map_);
     gicp->RecomputeSourceCovariance(
         recompute_covariance_scan_); // local scan we don't need to
@@ -279,6 +321,38 @@ bool PointCloudLocalization::SetupICP() {
     icp_ = ndt_omp;
     break;
   }
+  case RegistrationMethod::NDT_PYRAMID: {
+    ROS_INFO_STREAM("RegistrationMethod::NDT_PYRAMID activated.");
+    pclomp::NormalDistributionsTransform<PointF, PointF>::Ptr ndt_omp =
+        boost::make_shared<
+            pclomp::NormalDistributionsTransform<PointF, PointF>>();
+
+    ndt_omp->setTransformationEpsilon(params_.tf_epsilon);
+    ndt_omp->setMaxCorrespondenceDistance(params_.corr_dist);
+    ndt_omp->setMaximumIterations(params_.iterations);
+    ndt_omp->setRANSACIterations(0);
+    ndt_omp->setNumThreads(params_.num_threads);
+    ndt_omp->enableTimingOutput(params_.enable_timing_output);
+    // Coarse-to-fine: align at 4x and 2x the base resolution before the
+    // final pass at the base resolution.
+    ndt_omp->setResolutionPyramid(
+        {4.0f * ndt_omp->getResolution(), 2.0f * ndt_omp->getResolution()});
+    icp_ = ndt_omp;
+    break;
+  }
+  case RegistrationMethod::LOAM: {
+    ROS_INFO_STREAM("RegistrationMethod::LOAM activated.");
+    pcl::LoamFeatureRegistration<PointF, PointF>::Ptr loam =
+        boost::make_shared<pcl::LoamFeatureRegistration<PointF, PointF>>();
+
+    loam->setTransformationEpsilon(params_.tf_epsilon);
+    loam->setMaxCorrespondenceDistance(params_.corr_dist);
+    loam->setMaximumIterations(params_.iterations);
+    loam->setNumThreads(params_.num_threads);
+    loam->enableTimingOutput(params_.enable_timing_output);
+    icp_ = loam;
+    break;
+  }
   default:
     throw std::runtime_error(
         "No such Registration mode or not implemented yet " +
@@ -291,20 +365,67 @@ bool PointCloudLocalization::SetupICP() {
 bool PointCloudLocalization::MeasurementUpdate(
     const PointCloudF::Ptr& query,
     const PointCloudF::Ptr& reference,
-    PointCloudF* aligned_query) {
-  if (aligned_query == NULL) {
-    ROS_ERROR("%s: Output is null.", name_.c_str());
-    is_healthy_ = false;
-    return false;
-  }
+    PointCloudF* aligned_query,
+    const pcl::MultithreadedGeneralizedIterativeClosestPoint<
+        PointF,
+        PointF>::MatricesVectorPtr& query_covariances) {
+  // A null aligned_query means the caller has no consumer for the aligned
+  // scan (e.g. the debug cloud topic is unsubscribed), so producing it is
+  // skipped unless the correspondence fallback below needs it
 
   // Store time stamp
   ros::Time readed_stamp;
   readed_stamp.fromNSec(query->header.stamp * 1e3);
   stamp_ = readed_stamp;
 
+  const auto gicp = boost::dynamic_pointer_cast<
+      pcl::MultithreadedGeneralizedIterativeClosestPoint<PointF, PointF>>(icp_);
+
   icp_->setInputSource(query);
-  icp_->setInputTarget(reference);
+
+  // Target cache: rebuilding the target kd-tree (and its covariances for
+  // GICP) dominates this stage, yet when no points were inserted into the
+  // map and the robot stayed within the same pose cell, the extracted
+  // neighborhood is nearly identical frame to frame. Keep the previous
+  // target in that case and only call setInputTarget when the key changes.
+  // Downstream consumers index the cloud the held tree was built on
+  PointCloudF::Ptr target = reference;
+  if (params_.b_enable_target_cache) {
+    const double cell_size = params_.target_cache_cell_size > 0.0 ?
+        params_.target_cache_cell_size :
+        1.0;
+    const gu::Vec3& position = integrated_estimate_.translation;
+    const Eigen::Vector3i pose_cell(
+        static_cast<int>(std::floor(position(0) / cell_size)),
+        static_cast<int>(std::floor(position(1) / cell_size)),
+        static_cast<int>(std::floor(position(2) / cell_size)));
+    if (cached_reference_ != nullptr && cached_map_version_ == map_version_ &&
+        cached_pose_cell_ == pose_cell) {
+      target = cached_reference_;
+    } else {
+      // The caller reuses its neighborhood buffer every scan, so the cache
+      // keeps a deep copy and the tree is built on that: the held kd-tree
+      // must keep indexing the exact cloud contents on later cache hits
+      cached_reference_.reset(new PointCloudF(*reference));
+      icp_->setInputTarget(cached_reference_);
+      cached_map_version_ = map_version_;
+      cached_pose_cell_ = pose_cell;
+      target = cached_reference_;
+    }
+  } else {
+    icp_->setInputTarget(reference);
+  }
+
+  // Covariances travelling with the scan were already derived from its
+  // normals upstream, so hand them to GICP instead of converting again
+  // (setInputSource resets them, so this must come after). They are
+  // expressed in the sensor frame, hence unusable when the caller hands in
+  // fixed-frame clouds
+  if (gicp != nullptr && !params_.b_registration_in_fixed_frame &&
+      query_covariances != nullptr &&
+      query_covariances->size() == query->size()) {
+    gicp->setSourceCovariances(query_covariances);
+  }
 
   PointCloudF icpAlignedPointsLocalization_;
   icp_->align(icpAlignedPointsLocalization_);
@@ -322,47 +443,78 @@ bool PointCloudLocalization::MeasurementUpdate(
   //  ROS_INFO_STREAM("LOC TRANSFORM");
   //  const Eigen::Matrix4f T = gicp.getFinalTransformation();
 
-  pcl::transformPointCloudWithNormals(*query, *aligned_query, T);
-
-  KdTree::Ptr search_tree_ = icp_->getSearchMethodTarget();
-
-  // Get the correspondence indices iterate over references TODO?
-  std::vector<size_t> correspondences;
-  for (auto point : aligned_query->points) {
-    std::vector<int> matched_indices;
-    std::vector<float> matched_distances;
-    search_tree_->nearestKSearch(point, 1, matched_indices, matched_distances);
-    correspondences.push_back(matched_indices[0]);
+  if (aligned_query != NULL)
+    pcl::transformPointCloudWithNormals(*query, *aligned_query, T);
+
+  // Get the correspondence indices: GICP already searched the target tree in
+  // its final alignment iteration, so reuse its correspondences; NDT does not
+  // expose any, so fall back to the batched search
+  if (gicp != nullptr &&
+      gicp->getFinalCorrespondences().size() == query->size()) {
+    const std::vector<int>& final_correspondences =
+        gicp->getFinalCorrespondences();
+    correspondences_.resize(final_correspondences.size());
+    for (size_t i = 0; i < final_correspondences.size(); i++) {
+      // Points rejected by the correspondence distance threshold carry a -1
+      // sentinel; map it out of range so the Ap accumulation skips them
+      correspondences_[i] = final_correspondences[i] >= 0 ?
+          static_cast<size_t>(final_correspondences[i]) :
+          target->size();
+    }
+  } else if (aligned_query != NULL) {
+    SearchCorrespondences(*aligned_query, &correspondences_);
+  } else {
+    // The fallback search needs the aligned scan even when the caller does
+    // not
+    PointCloudF aligned_local;
+    pcl::transformPointCloudWithNormals(*query, aligned_local, T);
+    SearchCorrespondences(aligned_local, &correspondences_);
+  }
+  const std::vector<size_t>& correspondences = correspondences_;
+
+  // In fixed-frame registration mode T is the fixed-frame correction, i.e.
+  // the sensor-frame correction conjugated by the current estimate; undo the
+  // conjugation so the incremental update below sees the same quantity as in
+  // sensor-frame mode
+  Eigen::Matrix4f T_update = T;
+  if (params_.b_registration_in_fixed_frame) {
+    const gu::Transform3 estimate =
+        gu::PoseUpdate(integrated_estimate_, incremental_estimate_);
+    Eigen::Matrix4d E = Eigen::Matrix4d::Identity();
+    E.block(0, 0, 3, 3) = estimate.rotation.Eigen();
+    E.block(0, 3, 3, 1) = estimate.translation.Eigen();
+    T_update = (E.inverse() * T.cast<double>() * E).cast<float>();
   }
 
   gu::Transform3 pose_update;
 
   if (b_is_flat_ground_assumption_) {
-    tf::Matrix3x3 rotation(T(0, 0),
-                           T(0, 1),
-                           T(0, 2),
-                           T(1, 0),
-                           T(1, 1),
-                           T(1, 2),
-                           T(2, 0),
-                           T(2, 1),
-                           T(2, 2));
+    tf::Matrix3x3 rotation(T_update(0, 0),
+                           T_update(0, 1),
+                           T_update(0, 2),
+                           T_update(1, 0),
+                           T_update(1, 1),
+                           T_update(1, 2),
+                           T_update(2, 0),
+                           T_update(2, 1),
+                           T_update(2, 2));
     double roll, pitch, yaw;
     rotation.getRPY(roll, pitch, yaw);
-    pose_update.translation = gu::Vec3(T(0, 3), T(1, 3), 0);
+    pose_update.translation = gu::Vec3(T_update(0, 3), T_update(1, 3), 0);
     pose_update.rotation =
         gu::Rot3(cos(yaw), -sin(yaw), 0, sin(yaw), cos(yaw), 0, 0, 0, 1);
   } else {
-    pose_update.translation = gu::Vec3(T(0, 3), T(1, 3), T(2, 3));
-    pose_update.rotation = gu::Rot3(T(0, 0),
-                                    T(0, 1),
-                                    T(0, 2),
-                                    T(1, 0),
-                                    T(1, 1),
-                                    T(1, 2),
-                                    T(2, 0),
-                                    T(2, 1),
-                                    T(2, 2));
+    pose_update.translation =
+        gu::Vec3(T_update(0, 3), T_update(1, 3), T_update(2, 3));
+    pose_update.rotation = gu::Rot3(T_update(0, 0),
+                                    T_update(0, 1),
+                                    T_update(0, 2),
+                                    T_update(1, 0),
+                                    T_update(1, 1),
+                                    T_update(1, 2),
+                                    T_update(2, 0),
+                                    T_update(2, 1),
+                                    T_update(2, 2));
   }
 
   // Only update if the transform is small enough
@@ -381,13 +533,24 @@ bool PointCloudLocalization::MeasurementUpdate(
   integrated_estimate_ =
       gu::PoseUpdate(integrated_estimate_, incremental_estimate_);
 
-  if (params_.compute_icp_observability) {
+  // Reduced-rate mode: the full observability/covariance pipeline (Ap
+  // accumulation, LDLT, eigen decomposition) runs every n-th scan, or
+  // whenever the scan moved far enough that the last result is stale
+  scans_since_covariance_update_++;
+  const double translation_norm = pose_update.translation.Norm();
+  const bool b_full_covariance_update = !b_has_covariance_ ||
+      scans_since_covariance_update_ >=
+          params_.icp_covariance_recompute_every_n ||
+      (params_.icp_covariance_motion_threshold > 0.0 &&
+       translation_norm > params_.icp_covariance_motion_threshold);
+
+  if (params_.compute_icp_observability && b_full_covariance_update) {
     // Compute ICP obersvability (for lidar slip detection)
     Eigen::Matrix<double, 6, 6> eigenvectors_new;
     Eigen::Matrix<double, 6, 1> eigenvalues_new;
     observability_matrix_ = Eigen::Matrix<double, 6, 6>::Zero();
     ComputeIcpObservability(*query,
-                            *reference,
+                            *target,
                             correspondences,
                             T,
                             &eigenvectors_new,
@@ -398,8 +561,10 @@ bool PointCloudLocalization::MeasurementUpdate(
   {
     std::lock_guard<std::mutex> lock(icp_covariance_mutex_);
     // Compute the covariance matrix for the estimated transform
-    icp_covariance_ = Eigen::Matrix<double, 6, 6>::Zero();
-    if (params_.compute_icp_covariance) {
+    if (!params_.compute_icp_covariance) {
+      icp_covariance_ = Eigen::Matrix<double, 6, 6>::Zero();
+    } else if (b_full_covariance_update) {
+      icp_covariance_ = Eigen::Matrix<double, 6, 6>::Zero();
       switch (params_.icp_covariance_method) {
       case (0): {
         ROS_ERROR_STREAM(
@@ -411,21 +576,96 @@ bool PointCloudLocalization::MeasurementUpdate(
       }
       case (1):
         ComputePoint2PlaneICPCovariance(
-            *query, *reference, correspondences, T, &icp_covariance_);
+            *query, *target, correspondences, T, &icp_covariance_);
         break;
       default:
         ROS_ERROR(
             "Unknown method for ICP covariance calculation. Check config. ");
       }
+      last_computed_icp_covariance_ = icp_covariance_;
+    } else {
+      // Cheap propagation in between full updates: never report a tighter
+      // covariance than the last fully computed one, inflated by the squared
+      // displacement ratio when the scan moved further than the one the
+      // covariance was computed with
+      double ratio = 1.0;
+      if (covariance_reference_translation_ > 1e-6)
+        ratio = translation_norm / covariance_reference_translation_;
+      if (ratio < 1.0)
+        ratio = 1.0;
+      icp_covariance_ = last_computed_icp_covariance_ * (ratio * ratio);
     }
   }
 
+  if (b_full_covariance_update) {
+    scans_since_covariance_update_ = 0;
+    covariance_reference_translation_ = translation_norm;
+    b_has_covariance_ = true;
+  }
+
+  // Debug cloud topics: skipped entirely without subscribers, rate-limited
+  // and decimated otherwise
+  if (params_.b_publish_debug_clouds && DebugCloudDue()) {
+    PublishPoints(query, query_pub_);
+    PublishPoints(target, reference_pub_);
+    if (aligned_query != NULL && aligned_pub_.getNumSubscribers() > 0)
+      PublishPoints(boost::make_shared<PointCloudF>(*aligned_query),
+                    aligned_pub_);
+  }
+
   // TODO: Improve the healthy check.
   is_healthy_ = true;
 
   return true;
 }
 
+bool PointCloudLocalization::DebugCloudDue() {
+  if (stamp_ < next_debug_cloud_stamp_)
+    return false;
+  const double rate = params_.debug_cloud_publish_rate;
+  next_debug_cloud_stamp_ =
+      stamp_ + ros::Duration(rate > 0.0 ? 1.0 / rate : 0.0);
+  return true;
+}
+
+void PointCloudLocalization::PublishPoints(const PointCloudF::ConstPtr& points,
+                                           const ros::Publisher& pub) const {
+  // Nothing is produced or serialized without subscribers; publishing the
+  // shared pointer keeps same-process (nodelet) consumers zero-copy
+  if (pub.getNumSubscribers() == 0 || points == nullptr)
+    return;
+  if (params_.debug_cloud_decimation <= 1) {
+    pub.publish(points);
+    return;
+  }
+  PointCloudF::Ptr decimated(new PointCloudF());
+  decimated->header = points->header;
+  decimated->reserve(points->size() / params_.debug_cloud_decimation + 1);
+  for (size_t i = 0; i < points->size(); i += params_.debug_cloud_decimation)
+    decimated->push_back(points->points[i]);
+  pub.publish(decimated);
+}
+
+void PointCloudLocalization::SearchCorrespondences(
+    const PointCloudF& aligned_query, std::vector<size_t>* correspondences) {
+  KdTree::Ptr search_tree = icp_->getSearchMethodTarget();
+  // The index buffer persists across scans, so resizing reallocates nothing
+  // once it has grown to the steady-state scan size
+  correspondences->resize(aligned_query.size());
+  int enable_omp = (1 < params_.num_threads);
+#pragma omp parallel for num_threads(params_.num_threads) \
+    schedule(dynamic, 64) if (enable_omp)
+  for (size_t i = 0; i < aligned_query.size(); i++) {
+    // Per-iteration buffers: nearestKSearch is read-only on the tree, so the
+    // batch can be split across threads without locking
+    std::vector<int> matched_indices(1);
+    std::vector<float> matched_distances(1);
+    search_tree->nearestKSearch(
+        aligned_query[i], 1, matched_indices, matched_distances);
+    (*correspondences)[i] = matched_indices[0];
+  }
+}
+
 void PointCloudLocalization::SetFlatGroundAssumptionValue(const bool& value) {
   ROS_INFO_STREAM(
       "PointCloudLocalization - SetFlatGroundAssumptionValue - Received: "
@@ -436,6 +676,12 @@ void PointCloudLocalization::SetFlatGroundAssumptionValue(const bool& value) {
         gu::Rot3(0, 0, integrated_estimate_.rotation.Yaw());
 }
 
+void PointCloudLocalization::SetMaximumIterations(int iterations) {
+  params_.iterations = iterations;
+  if (icp_ != nullptr)
+    icp_->setMaximumIterations(iterations);
+}
+
 void PointCloudLocalization::ComputeIcpObservability(
     const PointCloudF& query_cloud,
     const PointCloudF& reference_cloud,
@@ -702,6 +948,10 @@ void PointCloudLocalization::ComputeAp_ForPoint2PlaneICP(
 
   Eigen::Vector3d a_i, n_i;
   for (uint32_t i = 0; i < query_normalized->size(); i++) {
+    // Skip points without a valid correspondence
+    if (correspondences[i] >= reference_normals->size())
+      continue;
+
     a_i << query_normalized->points[i].x, //////
         query_normalized->points[i].y,    //////
         query_normalized->points[i].z;
@@ -726,27 +976,22 @@ void PointCloudLocalization::ComputeAp_ForPoint2PlaneICP(
     const std::vector<size_t>& correspondences,
     const Eigen::Matrix4f& T,
     Eigen::Matrix<double, 6, 6>& Ap) {
-  Ap = Eigen::Matrix<double, 6, 6>::Zero();
-  Eigen::Matrix<double, 6, 6> A_i = Eigen::Matrix<double, 6, 6>::Zero();
-
-  Eigen::Vector3d a_i, n_i;
-  for (uint32_t i = 0; i < query_normalized->size(); i++) {
-    a_i << query_normalized->points[i].x, //////
-        query_normalized->points[i].y,    //////
-        query_normalized->points[i].z;
-
-    n_i << reference_normals.points[correspondences[i]].normal_x, //////
-        reference_normals.points[correspondences[i]].normal_y,    //////
-        reference_normals.points[correspondences[i]].normal_z;
-
-    if (a_i.hasNaN() || n_i.hasNaN())
-      continue;
-
-    Eigen::Matrix<double, 1, 6> H = Eigen::Matrix<double, 1, 6>::Zero();
-    H.block(0, 0, 1, 3) = (a_i.cross(n_i)).transpose();
-    H.block(0, 3, 1, 3) = n_i.transpose();
-    Ap += H.transpose() * H;
+  // Raise the stride beyond the configured one when the scan exceeds the
+  // correspondence cap
+  int stride = params_.icp_covariance_stride;
+  if (params_.icp_covariance_max_correspondences > 0) {
+    const int cap = params_.icp_covariance_max_correspondences;
+    const int cap_stride =
+        static_cast<int>((query_normalized->size() + cap - 1) / cap);
+    if (cap_stride > stride)
+      stride = cap_stride;
   }
+  computeAp_Point2Plane(*query_normalized,
+                        reference_normals,
+                        correspondences,
+                        Ap,
+                        params_.num_threads,
+                        stride);
 }
 
 diagnostic_msgs::DiagnosticStatus PointCloudLocalization::GetDiagnostics() {
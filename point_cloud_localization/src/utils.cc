@@ -1,5 +1,10 @@
 #include <point_cloud_localization/utils.h>
 
+namespace {
+// Block length of the SoA gather/accumulate kernel below
+const int kApBlockSize = 128;
+} // namespace
+
 void addNormal(const PointCloudF& cloud,
                pcl::PointCloud<pcl::PointNormal>::Ptr& cloud_with_normals,
                const int k_nearest_neighbours) {
@@ -127,6 +132,92 @@ void normalizePCloud(const PointCloudF& cloud,
   // checkIfPCloudIsNormalized(pclptr_normalized);  //
 }
 
+void computeAp_Point2Plane(const PointCloudF& query_normalized,
+                           const PointCloudF& reference_normals,
+                           const std::vector<size_t>& correspondences,
+                           Eigen::Matrix<double, 6, 6>& Ap,
+                           int num_threads,
+                           int stride) {
+  Ap = Eigen::Matrix<double, 6, 6>::Zero();
+  const size_t n_points = query_normalized.size();
+  if (n_points == 0 || correspondences.size() < n_points)
+    return;
+  if (stride < 1)
+    stride = 1;
+  if (num_threads < 1)
+    num_threads = 1;
+
+  // Number of (subsampled) correspondences and fixed-size blocks over them
+  const size_t n_samples = (n_points + stride - 1) / stride;
+  const size_t n_blocks = (n_samples + kApBlockSize - 1) / kApBlockSize;
+
+  // 21 unique entries of the symmetric 6x6 sum, upper triangle row-major
+  double acc_total[21] = {0.0};
+  int enable_omp = (1 < num_threads);
+#pragma omp parallel num_threads(num_threads) if (enable_omp)
+  {
+    double acc[21] = {0.0};
+    // SoA block: the six components of H_i stored row-contiguously so the
+    // products below run over unit-stride arrays
+    alignas(32) float h[6][kApBlockSize];
+#pragma omp for schedule(static)
+    for (size_t b = 0; b < n_blocks; b++) {
+      const size_t begin = b * kApBlockSize;
+      const size_t end =
+          begin + kApBlockSize < n_samples ? begin + kApBlockSize : n_samples;
+
+      // Gather pass: filter invalid correspondences and non-finite points
+      // while laying the H rows out in SoA order
+      int valid = 0;
+      for (size_t j = begin; j < end; j++) {
+        const size_t i = j * static_cast<size_t>(stride);
+        const size_t c = correspondences[i];
+        if (c >= reference_normals.size())
+          continue;
+        const PointF& a = query_normalized.points[i];
+        const PointF& n = reference_normals.points[c];
+        if (!std::isfinite(a.x + a.y + a.z) ||
+            !std::isfinite(n.normal_x + n.normal_y + n.normal_z))
+          continue;
+        h[0][valid] = a.y * n.normal_z - a.z * n.normal_y;
+        h[1][valid] = a.z * n.normal_x - a.x * n.normal_z;
+        h[2][valid] = a.x * n.normal_y - a.y * n.normal_x;
+        h[3][valid] = n.normal_x;
+        h[4][valid] = n.normal_y;
+        h[5][valid] = n.normal_z;
+        valid++;
+      }
+
+      // Accumulation pass: each unique entry of H' H is a dot product of two
+      // SoA rows
+      int k = 0;
+      for (int r = 0; r < 6; r++) {
+        for (int c = r; c < 6; c++, k++) {
+          float sum = 0.0f;
+#pragma omp simd reduction(+ : sum)
+          for (int j = 0; j < valid; j++)
+            sum += h[r][j] * h[c][j];
+          acc[k] += sum;
+        }
+      }
+    }
+#pragma omp critical
+    for (int k = 0; k < 21; k++)
+      acc_total[k] += acc[k];
+  }
+
+  int k = 0;
+  for (int r = 0; r < 6; r++) {
+    for (int c = r; c < 6; c++, k++) {
+      Ap(r, c) = acc_total[k];
+      Ap(c, r) = acc_total[k];
+    }
+  }
+  // Rescale so the subsampled sum estimates the full one
+  if (stride > 1)
+    Ap *= static_cast<double>(stride);
+}
+
 void doEigenDecomp6x6(const Eigen::Matrix<double, 6, 6>& data,
                       Eigen::Matrix<double, 6, 1>& eigenvalues,
                       Eigen::Matrix<double, 6, 6>& eigenvectors) {
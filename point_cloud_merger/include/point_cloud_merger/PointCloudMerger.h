@@ -14,6 +14,8 @@
 #include <pcl_conversions/pcl_conversions.h>
 #include <pcl_ros/point_cloud.h>
 #include <pcl_ros/transforms.h>
+#include <point_cloud_filter/BodyCropBox.h>
+#include <nav_msgs/Odometry.h>
 #include <ros/ros.h>
 #include <sensor_msgs/PointCloud2.h>
 #include <std_msgs/Int8.h>
@@ -57,6 +59,12 @@ private:
 
   // -----------------------------------------------------------------------
 
+  // Merge engine: copies the inputs into the persistent preallocated merge
+  // buffer with one parallel block copy per input, applying uniform-stride
+  // decimation during the copy when the random filter is enabled, so no
+  // temporary clouds are built and steady-state callbacks reallocate nothing
+  PointCloudF::Ptr MergeClouds(const std::vector<const PointCloudF*>& clouds);
+
   void PublishMergedPointCloud(const PointCloudF::ConstPtr combined_pc);
 
   std::string name_;
@@ -72,6 +80,31 @@ private:
   double radius_;
   unsigned int radius_knn_;
 
+  // Persistent merge output buffer, sized once to the largest combined cloud
+  PointCloudF::Ptr merged_cloud_;
+
+  // Robot body crop fused into the merge copy, replacing the body filter
+  // nodelet hop each sensor cloud used to take before reaching the merger
+  point_cloud_filter::BodyCropBox<PointF> body_crop_;
+
+  /*
+  Motion de-skew -----------------------------------------------------------
+  The inputs arrive pre-transformed into the common base frame, but their
+  points were captured over one revolution while the robot moved. When
+  enabled, each point is corrected to the end of its sweep using the latest
+  ego-motion twist, with its capture time derived from its azimuth. Fused
+  into the merge copy so it costs no extra pass
+  */
+  bool b_use_deskew_;
+  double scan_period_;
+  ros::Subscriber deskew_odometry_sub_;
+  void OdometryCallback(const nav_msgs::Odometry& msg);
+  void DeskewPoint(PointF& point) const;
+  Eigen::Vector3d angular_velocity_;
+  Eigen::Vector3d linear_velocity_;
+  bool b_have_twist_;
+  // ------------------------------------------------------------------------
+
   int pcld_queue_size_{
       10}; // Approximate time policy queue size to synchronize point clouds
 
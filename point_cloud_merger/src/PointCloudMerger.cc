@@ -1,9 +1,16 @@
 #include <point_cloud_merger/PointCloudMerger.h>
 
+#include <cmath>
+
 namespace pu = parameter_utils;
 
 PointCloudMerger::PointCloudMerger()
-  : b_use_random_filter_(false), b_use_radius_filter_(false) {}
+  : b_use_random_filter_(false),
+    b_use_radius_filter_(false),
+    b_use_deskew_(false),
+    b_have_twist_(false),
+    angular_velocity_(Eigen::Vector3d::Zero()),
+    linear_velocity_(Eigen::Vector3d::Zero()) {}
 
 PointCloudMerger::~PointCloudMerger() {}
 
@@ -38,6 +45,41 @@ bool PointCloudMerger::LoadParameters(const ros::NodeHandle& n) {
     return false;
   if (!pu::Get("merging/radius_knn", radius_knn_))
     return false;
+  if (!pu::Get("merging/b_use_deskew", b_use_deskew_))
+    return false;
+  if (!pu::Get("merging/scan_period", scan_period_))
+    return false;
+
+  // Body box the crop kernel drops self-hit points from during the merge
+  // copy, replacing the body filter nodelet in front of the merger
+  bool b_body_filter;
+  double body_min_x, body_max_x, body_min_y, body_max_y, body_min_z,
+      body_max_z, body_rotation;
+  if (!pu::Get("merging/body_filter/enabled", b_body_filter))
+    return false;
+  if (!pu::Get("merging/body_filter/min_x", body_min_x))
+    return false;
+  if (!pu::Get("merging/body_filter/max_x", body_max_x))
+    return false;
+  if (!pu::Get("merging/body_filter/min_y", body_min_y))
+    return false;
+  if (!pu::Get("merging/body_filter/max_y", body_max_y))
+    return false;
+  if (!pu::Get("merging/body_filter/min_z", body_min_z))
+    return false;
+  if (!pu::Get("merging/body_filter/max_z", body_max_z))
+    return false;
+  if (!pu::Get("merging/body_filter/rotation", body_rotation))
+    return false;
+  body_crop_.Configure(b_body_filter,
+                       static_cast<float>(body_min_x),
+                       static_cast<float>(body_max_x),
+                       static_cast<float>(body_min_y),
+                       static_cast<float>(body_max_y),
+                       static_cast<float>(body_min_z),
+                       static_cast<float>(body_max_z),
+                       static_cast<float>(body_rotation));
+
   return true;
 }
 
@@ -55,6 +97,11 @@ bool PointCloudMerger::RegisterCallbacks(const ros::NodeHandle& n) {
                     &PointCloudMerger::ResurrectionDetectionCallback,
                     this);
 
+  if (b_use_deskew_) {
+    deskew_odometry_sub_ = nl_.subscribe(
+        "deskew_odometry", 10, &PointCloudMerger::OdometryCallback, this);
+  }
+
   pcld0_sub_ = new message_filters::Subscriber<PointCloudF>(nl_, "pcld0", 10);
   pcld1_sub_ = new message_filters::Subscriber<PointCloudF>(nl_, "pcld1", 10);
   id_to_sub_map_.insert({0, pcld0_sub_});
@@ -95,20 +142,140 @@ bool PointCloudMerger::CreatePublishers(const ros::NodeHandle& n) {
   return true;
 }
 
+void PointCloudMerger::OdometryCallback(const nav_msgs::Odometry& msg) {
+  angular_velocity_ = Eigen::Vector3d(msg.twist.twist.angular.x,
+                                      msg.twist.twist.angular.y,
+                                      msg.twist.twist.angular.z);
+  linear_velocity_ = Eigen::Vector3d(msg.twist.twist.linear.x,
+                                     msg.twist.twist.linear.y,
+                                     msg.twist.twist.linear.z);
+  b_have_twist_ = true;
+}
+
+// Corrects one point to the end of its sweep using the latest twist. PointF
+// carries no per-point time channel, so the capture time is recovered from
+// the point azimuth as a fraction of the scan period
+void PointCloudMerger::DeskewPoint(PointF& point) const {
+  const double azimuth_fraction =
+      (std::atan2(point.y, point.x) + M_PI) / (2.0 * M_PI);
+  const double dt = (azimuth_fraction - 1.0) * scan_period_;
+
+  const Eigen::Vector3d rotation_vector = angular_velocity_ * dt;
+  const double angle = rotation_vector.norm();
+  Eigen::Matrix3d rotation = Eigen::Matrix3d::Identity();
+  if (angle > 0.0) {
+    rotation =
+        Eigen::AngleAxisd(angle, rotation_vector / angle).toRotationMatrix();
+  }
+  const Eigen::Vector3d translation = linear_velocity_ * dt;
+
+  const Eigen::Vector3d corrected =
+      rotation * Eigen::Vector3d(point.x, point.y, point.z) + translation;
+  point.x = corrected.x();
+  point.y = corrected.y();
+  point.z = corrected.z();
+  const Eigen::Vector3d corrected_normal = rotation *
+      Eigen::Vector3d(point.normal_x, point.normal_y, point.normal_z);
+  point.normal_x = corrected_normal.x();
+  point.normal_y = corrected_normal.y();
+  point.normal_z = corrected_normal.z();
+}
+
 // TODO:
 // Reduce---------------------------------------------------------------------------------
 
-void PointCloudMerger::OnePointCloudCallback(const PointCloudF::ConstPtr& a) {
-  PointCloudF::Ptr cloud(new PointCloudF(*a));
+PointCloudF::Ptr
+PointCloudMerger::MergeClouds(const std::vector<const PointCloudF*>& clouds) {
+  if (!merged_cloud_) {
+    merged_cloud_.reset(new PointCloudF());
+  }
 
+  // Decimation is fused into the copy as a uniform stride over each input,
+  // replacing the post-merge random sampling pass
+  double keep_ratio = 1.0;
   if (b_use_random_filter_) {
-    const int n_points =
-        static_cast<int>((1.0 - decimate_percentage_) * cloud->size());
-    pcl::RandomSample<PointF> random_filter;
-    random_filter.setSample(n_points);
-    random_filter.setInputCloud(cloud);
-    random_filter.filter(*cloud);
+    keep_ratio = 1.0 - decimate_percentage_;
+  }
+
+  // Output offset of each input, given the number of points it keeps
+  std::vector<size_t> offsets(clouds.size() + 1, 0);
+  for (size_t k = 0; k < clouds.size(); k++) {
+    const size_t cloud_size = clouds[k]->size();
+    size_t kept = 0;
+    if (keep_ratio >= 1.0) {
+      kept = cloud_size;
+    } else if (keep_ratio > 0.0 && cloud_size > 0) {
+      const double stride = 1.0 / keep_ratio;
+      kept = static_cast<size_t>((cloud_size - 1) / stride) + 1;
+    }
+    offsets[k + 1] = offsets[k] + kept;
+  }
+
+  merged_cloud_->resize(offsets.back());
+
+  // De-skew and the body crop are fused into the same pass: they force the
+  // per-point copy but cost no extra sweep over the merged cloud. The crop
+  // compacts each input's segment with an unconditional write and a masked
+  // cursor advance, so no branch depends on the box test
+  const bool b_deskew = b_use_deskew_ && b_have_twist_;
+  const bool b_crop = body_crop_.Enabled();
+
+  std::vector<size_t> kept_counts(clouds.size(), 0);
+
+  int enable_omp = (1 < clouds.size());
+#pragma omp parallel for schedule(dynamic, 1) if (enable_omp)
+  for (size_t k = 0; k < clouds.size(); k++) {
+    const PointCloudF& in = *clouds[k];
+    const size_t kept = offsets[k + 1] - offsets[k];
+    if (kept == 0) {
+      continue;
+    }
+    PointF* out = &merged_cloud_->points[offsets[k]];
+    if (kept == in.size() && !b_deskew && !b_crop) {
+      std::copy(in.points.begin(), in.points.end(), out);
+      kept_counts[k] = kept;
+    } else {
+      const double stride = static_cast<double>(in.size()) / kept;
+      size_t write = 0;
+      for (size_t w = 0; w < kept; w++) {
+        out[write] = in[static_cast<size_t>(w * stride)];
+        if (b_deskew) {
+          DeskewPoint(out[write]);
+        }
+        write +=
+            static_cast<size_t>(!(b_crop && body_crop_.Contains(out[write])));
+      }
+      kept_counts[k] = write;
+    }
+  }
+
+  // Close the gaps the crop left between segments. Without the crop every
+  // segment is full and this degenerates to updating the total
+  size_t total = 0;
+  for (size_t k = 0; k < clouds.size(); k++) {
+    if (offsets[k] != total && kept_counts[k] > 0) {
+      std::copy(merged_cloud_->points.begin() + offsets[k],
+                merged_cloud_->points.begin() + offsets[k] + kept_counts[k],
+                merged_cloud_->points.begin() + total);
+    }
+    total += kept_counts[k];
   }
+  merged_cloud_->resize(total);
+
+  merged_cloud_->header = clouds[0]->header;
+  merged_cloud_->width = merged_cloud_->size();
+  merged_cloud_->height = 1;
+  bool b_is_dense = true;
+  for (size_t k = 0; k < clouds.size(); k++) {
+    b_is_dense = b_is_dense && clouds[k]->is_dense;
+  }
+  merged_cloud_->is_dense = b_is_dense;
+  return merged_cloud_;
+}
+
+void PointCloudMerger::OnePointCloudCallback(const PointCloudF::ConstPtr& a) {
+  PointCloudF::Ptr cloud = MergeClouds({a.get()});
+
   if (b_use_radius_filter_) {
     pcl::RadiusOutlierRemoval<PointF> rad;
     rad.setInputCloud(cloud);
@@ -122,20 +289,8 @@ void PointCloudMerger::OnePointCloudCallback(const PointCloudF::ConstPtr& a) {
 
 void PointCloudMerger::TwoPointCloudCallback(const PointCloudF::ConstPtr& a,
                                              const PointCloudF::ConstPtr& b) {
-  //  PointCloudF p1, p2;
-  //  pcl::fromROSMsg(*a, p1);
-  //  pcl::fromROSMsg(*b, p2);
+  PointCloudF::Ptr sum = MergeClouds({a.get(), b.get()});
 
-  PointCloudF::Ptr sum(new PointCloudF(PointCloudF(*a) + PointCloudF(*b)));
-
-  if (b_use_random_filter_) {
-    const int n_points =
-        static_cast<int>((1.0 - decimate_percentage_) * sum->size());
-    pcl::RandomSample<PointF> random_filter;
-    random_filter.setSample(n_points);
-    random_filter.setInputCloud(sum);
-    random_filter.filter(*sum);
-  }
   if (b_use_radius_filter_) {
     pcl::RadiusOutlierRemoval<PointF> rad;
     rad.setInputCloud(sum);
@@ -150,22 +305,8 @@ void PointCloudMerger::TwoPointCloudCallback(const PointCloudF::ConstPtr& a,
 void PointCloudMerger::ThreePointCloudCallback(const PointCloudF::ConstPtr& a,
                                                const PointCloudF::ConstPtr& b,
                                                const PointCloudF::ConstPtr& c) {
-  //  PointCloudF p1, p2, p3;
-  //  pcl::fromROSMsg(*a, p1);
-  //  pcl::fromROSMsg(*b, p2);
-  //  pcl::fromROSMsg(*c, p3);
-
-  PointCloudF::Ptr sum(
-      new PointCloudF(PointCloudF(*a) + (PointCloudF(*b) + PointCloudF(*c))));
+  PointCloudF::Ptr sum = MergeClouds({a.get(), b.get(), c.get()});
 
-  if (b_use_random_filter_) {
-    const int n_points =
-        static_cast<int>((1.0 - decimate_percentage_) * sum->size());
-    pcl::RandomSample<PointF> random_filter;
-    random_filter.setSample(n_points);
-    random_filter.setInputCloud(sum);
-    random_filter.filter(*sum);
-  }
   if (b_use_radius_filter_) {
     pcl::RadiusOutlierRemoval<PointF> rad;
     rad.setInputCloud(sum);
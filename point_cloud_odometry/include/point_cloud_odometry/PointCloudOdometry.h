@@ -45,6 +45,7 @@
 #include <geometry_utils/GeometryUtilsROS.h>
 #include <geometry_utils/Transform3.h>
 #include <multithreaded_gicp/gicp.h>
+#include <multithreaded_loam/loam.h>
 #include <multithreaded_ndt/ndt_omp.h>
 #include <nav_msgs/Odometry.h>
 #include <parameter_utils/ParameterUtils.h>
@@ -67,6 +68,9 @@ public:
   bool Initialize(const ros::NodeHandle& n);
 
   bool SetLidar(const PointCloudF& points);
+  // Zero-copy variant: the caller hands over a shared cloud and must not
+  // mutate it afterwards, as it is kept as the reference for the next frame
+  bool SetLidar(const PointCloudF::ConstPtr& points);
   bool SetImuDelta(const Eigen::Matrix3d& imu_delta);
   bool SetOdometryDelta(const tf::Transform& odometry_delta);
 
@@ -77,7 +81,15 @@ public:
   geometry_utils::Transform3 incremental_estimate_;
   geometry_utils::Transform3 integrated_estimate_;
 
-  bool GetLastPointCloud(PointCloudF::Ptr& out) const;
+  bool GetLastPointCloud(PointCloudF::ConstPtr& out) const;
+
+  // Covariances GICP derived from the query normals during the last
+  // UpdateEstimate, or nullptr when NDT is active. They belong to the scan
+  // last handed to SetLidar and can be consumed by another registration
+  // instance aligning the same scan
+  pcl::MultithreadedGeneralizedIterativeClosestPoint<PointF, PointF>::
+      MatricesVectorPtr
+      GetQueryCovariances() const;
 
   // Aligned point cloud returned by ICP
   PointCloudF icpAlignedPointsOdometry_;
@@ -104,6 +116,15 @@ private:
   void PublishPose(const geometry_utils::Transform3& pose,
                    const ros::Publisher& pub);
 
+  // Rate gate shared by the debug cloud topics: true at most
+  // debug_cloud_publish_rate times per second of scan time
+  bool DebugCloudDue();
+
+  // Publish a debug cloud: skipped without subscribers, decimated when
+  // configured, handed off by shared pointer for intra-process consumers
+  void PublishPoints(const PointCloudF::ConstPtr& points,
+                     const ros::Publisher& pub) const;
+
   std::string name_;
   bool b_verbose_;
   bool initialized_;
@@ -117,18 +138,18 @@ private:
   // Most recent point cloud time stamp for publishers
   ros::Time stamp_;
 
+  // Scan time before which no debug cloud is published
+  ros::Time next_debug_cloud_stamp_;
+
   // Coordinate frames
   std::string fixed_frame_id_;
   std::string odometry_frame_id_;
 
-  // Point cloud containers
-  PointCloudF points_;
-  PointCloudF::Ptr query_;
-  PointCloudF::Ptr reference_;
-
-  // Query point cloud container
-
-  PointCloudF::Ptr query_trans_;
+  // Point cloud containers. These are shared const handles rotated between
+  // frames (points -> query -> reference) so no per-scan copies are made
+  PointCloudF::ConstPtr points_;
+  PointCloudF::ConstPtr query_;
+  PointCloudF::ConstPtr reference_;
 
   // Maximum acceptable translation and rotation tolerances
   // If transform_thresholding_ is set to false,
@@ -148,6 +169,13 @@ private:
     int num_threads;
     // Enable GICP timing information print logs
     bool enable_timing_output;
+    // Publish the query/reference debug clouds. Nothing is produced
+    // without subscribers even when enabled
+    bool b_publish_debug_clouds;
+    // Ceiling on the debug cloud publish rate in Hz
+    double debug_cloud_publish_rate;
+    // Keep every n-th point of a published debug cloud (1 = full cloud)
+    int debug_cloud_decimation;
 
   } params_;
 
@@ -11,17 +11,13 @@ namespace gu = geometry_utils;
 namespace gr = gu::ros;
 namespace pu = parameter_utils;
 
-using pcl::copyPointCloud;
-
 PointCloudOdometry::PointCloudOdometry()
   : initialized_(false),
     b_use_imu_integration_(false),
     b_use_odometry_integration_(false) {
+  points_.reset(new PointCloudF);
   query_.reset(new PointCloudF);
   reference_.reset(new PointCloudF);
-  query_trans_.reset(new PointCloudF);
-  query_trans_->reserve(50000);
-  query_trans_->clear();
 }
 
 PointCloudOdometry::~PointCloudOdometry() {}
@@ -89,6 +85,13 @@ bool PointCloudOdometry::LoadParameters(const ros::NodeHandle& n) {
     return false;
   if (!pu::Get("icp/recompute_covariances", recompute_covariances_))
     return false;
+  if (!pu::Get("icp/b_publish_debug_clouds", params_.b_publish_debug_clouds))
+    return false;
+  if (!pu::Get("icp/debug_cloud_publish_rate",
+               params_.debug_cloud_publish_rate))
+    return false;
+  if (!pu::Get("icp/debug_cloud_decimation", params_.debug_cloud_decimation))
+    return false;
 
   if (!pu::Get("b_verbose", b_verbose_))
     return false;
@@ -194,6 +197,38 @@ bool PointCloudOdometry::SetupICP() {
     icp_ = ndt_omp;
     break;
   }
+  case RegistrationMethod::NDT_PYRAMID: {
+    ROS_INFO_STREAM("RegistrationMethod::NDT_PYRAMID activated.");
+    pclomp::NormalDistributionsTransform<PointF, PointF>::Ptr ndt_omp =
+        boost::make_shared<
+            pclomp::NormalDistributionsTransform<PointF, PointF>>();
+
+    ndt_omp->setTransformationEpsilon(params_.icp_tf_epsilon);
+    ndt_omp->setMaxCorrespondenceDistance(params_.icp_corr_dist);
+    ndt_omp->setMaximumIterations(params_.icp_iterations);
+    ndt_omp->setRANSACIterations(0);
+    ndt_omp->setNumThreads(params_.num_threads);
+    ndt_omp->enableTimingOutput(params_.enable_timing_output);
+    // Coarse-to-fine: align at 4x and 2x the base resolution before the
+    // final pass at the base resolution.
+    ndt_omp->setResolutionPyramid(
+        {4.0f * ndt_omp->getResolution(), 2.0f * ndt_omp->getResolution()});
+    icp_ = ndt_omp;
+    break;
+  }
+  case RegistrationMethod::LOAM: {
+    ROS_INFO_STREAM("RegistrationMethod::LOAM activated.");
+    pcl::LoamFeatureRegistration<PointF, PointF>::Ptr loam =
+        boost::make_shared<pcl::LoamFeatureRegistration<PointF, PointF>>();
+
+    loam->setTransformationEpsilon(params_.icp_tf_epsilon);
+    loam->setMaxCorrespondenceDistance(params_.icp_corr_dist);
+    loam->setMaximumIterations(params_.icp_iterations);
+    loam->setNumThreads(params_.num_threads);
+    loam->enableTimingOutput(params_.enable_timing_output);
+    icp_ = loam;
+    break;
+  }
 
   default:
     throw std::runtime_error(
@@ -219,7 +254,11 @@ void PointCloudOdometry::DisableSensorIntegration() {
 }
 
 bool PointCloudOdometry::SetLidar(const PointCloudF& points) {
-  stamp_.fromNSec(points.header.stamp * 1e3);
+  return SetLidar(boost::make_shared<PointCloudF>(points));
+}
+
+bool PointCloudOdometry::SetLidar(const PointCloudF::ConstPtr& points) {
+  stamp_.fromNSec(points->header.stamp * 1e3);
   points_ = points;
   return true;
 }
@@ -235,45 +274,42 @@ bool PointCloudOdometry::SetOdometryDelta(const tf::Transform& odometry_delta) {
 }
 
 bool PointCloudOdometry::UpdateEstimate() {
+  // Rotate the shared handles instead of copying clouds: the previous query
+  // becomes the reference and the latest scan becomes the query
   if (!initialized_) {
-    copyPointCloud(points_, *query_);
+    query_ = points_;
     initialized_ = true;
     return false;
   } else {
-    copyPointCloud(*query_, *reference_);
-    copyPointCloud(points_, *query_);
+    reference_ = query_;
+    query_ = points_;
     return UpdateICP();
   }
 }
 
 bool PointCloudOdometry::UpdateICP() {
-  query_trans_->clear();
-
+  // The prior is fed to the optimizer as its initial guess rather than baked
+  // into a transformed copy of the query, so no per-scan full-cloud
+  // transform is needed and the final transformation already contains the
+  // prior composed in
+  Eigen::Matrix4f prior = Eigen::Matrix4f::Identity();
   if (b_use_imu_integration_) {
     imu_prior_ << 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1;
     imu_prior_.block(0, 0, 3, 3) = imu_delta_;
-    pcl::transformPointCloud(*query_, *query_trans_, imu_prior_);
+    prior = imu_prior_.cast<float>();
   } else if (b_use_odometry_integration_) {
     Eigen::Matrix4f temp;
     pcl_ros::transformAsMatrix(odometry_delta_, temp);
     odometry_prior_ = temp.cast<double>();
-    pcl::transformPointCloud(*query_, *query_trans_, odometry_prior_);
-  } else {
-    *query_trans_ = *query_;
+    prior = temp;
   }
 
-  icp_->setInputSource(query_trans_);
+  icp_->setInputSource(query_);
   icp_->setInputTarget(reference_);
-  icp_->align(icpAlignedPointsOdometry_);
+  icp_->align(icpAlignedPointsOdometry_, prior);
   Eigen::Matrix4d T;
   T = icp_->getFinalTransformation().cast<double>();
 
-  if (b_use_imu_integration_) {
-    T = T * imu_prior_;
-  } else if (b_use_odometry_integration_) {
-    T = T * odometry_prior_;
-  } 
-
   if (b_is_flat_ground_assumption_) {
     tf::Matrix3x3 rotation(T(0, 0),
                            T(0, 1),
@@ -339,7 +375,7 @@ const gu::Transform3& PointCloudOdometry::GetIntegratedEstimate() const {
   return integrated_estimate_;
 }
 
-bool PointCloudOdometry::GetLastPointCloud(PointCloudF::Ptr& out) const {
+bool PointCloudOdometry::GetLastPointCloud(PointCloudF::ConstPtr& out) const {
   if (!initialized_ || query_ == NULL) {
     ROS_WARN("%s: Not initialized.", name_.c_str());
     return false;
@@ -348,9 +384,54 @@ bool PointCloudOdometry::GetLastPointCloud(PointCloudF::Ptr& out) const {
   return true;
 }
 
+pcl::MultithreadedGeneralizedIterativeClosestPoint<PointF, PointF>::
+    MatricesVectorPtr
+    PointCloudOdometry::GetQueryCovariances() const {
+  const auto gicp = boost::dynamic_pointer_cast<
+      pcl::MultithreadedGeneralizedIterativeClosestPoint<PointF, PointF>>(icp_);
+  if (gicp == nullptr) {
+    return nullptr;
+  }
+  return gicp->getSourceCovariances();
+}
+
 void PointCloudOdometry::PublishAll() {
   PublishPose(incremental_estimate_, incremental_estimate_pub_);
   PublishPose(integrated_estimate_, integrated_estimate_pub_);
+
+  // Debug cloud topics: skipped entirely without subscribers, rate-limited
+  // and decimated otherwise
+  if (params_.b_publish_debug_clouds && DebugCloudDue()) {
+    PublishPoints(query_, query_pub_);
+    PublishPoints(reference_, reference_pub_);
+  }
+}
+
+bool PointCloudOdometry::DebugCloudDue() {
+  if (stamp_ < next_debug_cloud_stamp_)
+    return false;
+  const double rate = params_.debug_cloud_publish_rate;
+  next_debug_cloud_stamp_ =
+      stamp_ + ros::Duration(rate > 0.0 ? 1.0 / rate : 0.0);
+  return true;
+}
+
+void PointCloudOdometry::PublishPoints(const PointCloudF::ConstPtr& points,
+                                       const ros::Publisher& pub) const {
+  // Nothing is produced or serialized without subscribers; publishing the
+  // shared pointer keeps same-process (nodelet) consumers zero-copy
+  if (pub.getNumSubscribers() == 0 || points == nullptr)
+    return;
+  if (params_.debug_cloud_decimation <= 1) {
+    pub.publish(points);
+    return;
+  }
+  PointCloudF::Ptr decimated(new PointCloudF());
+  decimated->header = points->header;
+  decimated->reserve(points->size() / params_.debug_cloud_decimation + 1);
+  for (size_t i = 0; i < points->size(); i += params_.debug_cloud_decimation)
+    decimated->push_back(points->points[i]);
+  pub.publish(decimated);
 }
 
 void PointCloudOdometry::PublishPose(const gu::Transform3& pose,
@@ -187,7 +187,7 @@ protected:
     return pco.b_is_flat_ground_assumption_;
   }
   PointCloudF GetPoints() {
-    return pco.points_;
+    return *pco.points_;
   }
   Eigen::Matrix3d GetImuDelta() {
     return pco.imu_delta_;
@@ -264,7 +264,7 @@ TEST_F(PointCloudOdometryTest, GetDiagnostics) {
 }
 
 TEST_F(PointCloudOdometryTest, GetLastPointCloud) {
-  PointCloudF::Ptr pc(new PointCloudF);
+  PointCloudF::ConstPtr pc(new PointCloudF);
   EXPECT_FALSE(pco.GetLastPointCloud(pc));
   pco.UpdateEstimate();
   EXPECT_TRUE(pco.GetLastPointCloud(pc));
@@ -0,0 +1,83 @@
+"""
+Description:
+    - A script to inspect the binary scan logs written by locus
+      (scan_log/b_log_scans, format in locus/include/locus/ScanLogger.h).
+      Walks the log through numpy views over an mmap (no copies) and
+      prints per-scan stats; use iterate_records() from other scripts to
+      get the raw arrays
+Author:
+    - Matteo Palieri, NASA Jet Propulsion Laboratory
+"""
+import mmap
+import struct
+import sys
+
+import numpy as np
+
+MAGIC = b"LOCUSLOG"
+VERSION = 1
+
+FILE_HEADER = struct.Struct("<8sII")
+# stamp, point_count, has_imu, has_odometry, pad, imu[10], odometry[13]
+RECORD_HEADER = struct.Struct("<dIBB2x10d13d")
+POINT_DTYPE = np.dtype([
+    ("x", np.float32), ("y", np.float32), ("z", np.float32),
+    ("intensity", np.float32),
+    ("normal_x", np.float32), ("normal_y", np.float32),
+    ("normal_z", np.float32),
+    ("curvature", np.float32),
+])
+
+
+def iterate_records(path):
+    with open(path, "rb") as f:
+        buf = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+    magic, version, point_stride = FILE_HEADER.unpack_from(buf, 0)
+    if magic != MAGIC or version != VERSION:
+        raise ValueError("not a locus scan log: " + path)
+    if point_stride != POINT_DTYPE.itemsize:
+        raise ValueError("unexpected point stride: " + str(point_stride))
+    offset = FILE_HEADER.size
+    while offset + RECORD_HEADER.size <= len(buf):
+        fields = RECORD_HEADER.unpack_from(buf, offset)
+        offset += RECORD_HEADER.size
+        stamp, point_count, has_imu, has_odometry = fields[:4]
+        imu = np.array(fields[4:14]) if has_imu else None
+        odometry = np.array(fields[14:27]) if has_odometry else None
+        block_size = point_count * POINT_DTYPE.itemsize
+        if offset + block_size > len(buf):
+            break
+        points = np.frombuffer(buf, dtype=POINT_DTYPE, count=point_count,
+                               offset=offset)
+        offset += block_size
+        yield stamp, points, imu, odometry
+
+
+def print_summary(path):
+    count = 0
+    total_points = 0
+    first_stamp = None
+    last_stamp = None
+    for stamp, points, imu, odometry in iterate_records(path):
+        if first_stamp is None:
+            first_stamp = stamp
+        last_stamp = stamp
+        count += 1
+        total_points += len(points)
+        print("scan %d: stamp %.6f, %d points, imu %s, odometry %s"
+              % (count - 1, stamp, len(points),
+                 "yes" if imu is not None else "no",
+                 "yes" if odometry is not None else "no"))
+    if count == 0:
+        print("empty log")
+        return
+    print("%d scans, %d points total (%.1f avg), %.2f s of data"
+          % (count, total_points, float(total_points) / count,
+             last_stamp - first_stamp))
+
+
+if __name__ == "__main__":
+    if len(sys.argv) < 2:
+        print("usage: scan_log_reader.py <scan_log>")
+        sys.exit(1)
+    print_summary(sys.argv[1])